@@ -0,0 +1,58 @@
+// Setup shared by the benchmarks. Each benchmark stores its tasks in its own
+// archive file, which is removed before the archive is opened and after it's
+// destroyed, so that every run starts empty and leaves nothing behind.
+
+#ifndef __TASK_DISTRIBUTION__BENCHMARK_HPP__
+#define __TASK_DISTRIBUTION__BENCHMARK_HPP__
+
+#include "task_manager.hpp"
+
+#include <cstdio>
+#include <memory>
+#include <string>
+
+namespace TaskDistribution {
+  class BenchmarkArchive {
+    public:
+      explicit BenchmarkArchive(std::string const& file_name):
+        file_name_(file_name) {
+        remove(file_name_.c_str());
+        archive_.reset(new ObjectArchive<Key>());
+        archive_->init(file_name_);
+      }
+
+      // The archive is written when destroyed, so it's destroyed before the
+      // file is removed.
+      ~BenchmarkArchive() {
+        archive_.reset();
+        remove(file_name_.c_str());
+      }
+
+      ObjectArchive<Key>& get() { return *archive_; }
+
+    private:
+      std::string file_name_;
+      std::unique_ptr<ObjectArchive<Key>> archive_;
+  };
+
+  // Manager without the task creation handler, whose printing would take most
+  // of the time measured.
+  class BenchmarkManager {
+    public:
+      explicit BenchmarkManager(std::string const& file_name):
+        archive_(file_name),
+        unit_manager_(archive_.get()),
+        task_manager_(archive_.get(), unit_manager_) {
+        task_manager_.clear_task_creation_handler();
+      }
+
+      TaskManager& get() { return task_manager_; }
+
+    private:
+      BenchmarkArchive archive_;
+      ComputingUnitManager unit_manager_;
+      TaskManager task_manager_;
+  };
+};
+
+#endif
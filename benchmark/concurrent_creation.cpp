@@ -0,0 +1,72 @@
+// Measures how task creation scales with the number of threads creating tasks.
+// Each thread creates its own chains of tasks, like benchmark/new_task.cpp, so
+// that threads only share the manager.
+//
+// Usage: concurrent_creation.bin [number of tasks] [maximum threads]
+
+#include "benchmark.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+class Sum: public TaskDistribution::ComputingUnit<Sum> {
+  public:
+    Sum(): ComputingUnit<Sum>("sum") {}
+
+    int operator()(int v1, int v2) const {
+      return v1 + v2;
+    }
+};
+
+void create_tasks(TaskDistribution::TaskManager& task_manager, size_t first,
+    size_t last, size_t chain_length) {
+  TaskDistribution::Task<int> task;
+
+  for (size_t i = first; i < last; i++) {
+    if (i % chain_length == 0 || i == first)
+      task = task_manager.new_identity_task((int)i);
+    else
+      task = task_manager.new_task(Sum(), task, (int)i);
+  }
+}
+
+double measure(size_t n_tasks, size_t n_threads) {
+  TaskDistribution::BenchmarkManager manager("concurrent_creation.archive");
+  TaskDistribution::TaskManager& task_manager = manager.get();
+
+  auto begin = std::chrono::steady_clock::now();
+
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < n_threads; i++)
+    threads.emplace_back(create_tasks, std::ref(task_manager),
+        n_tasks * i / n_threads, n_tasks * (i + 1) / n_threads, 100);
+
+  for (auto& thread : threads)
+    thread.join();
+
+  auto end = std::chrono::steady_clock::now();
+
+  return n_tasks / std::chrono::duration<double>(end - begin).count();
+}
+
+int main(int argc, char* argv[]) {
+  size_t n_tasks = argc > 1 ? atol(argv[1]) : 200000;
+  size_t max_threads = argc > 2 ? atol(argv[2]) :
+    std::max<size_t>(std::thread::hardware_concurrency(), 1);
+
+  printf("%zu tasks in chains of 100\n\n", n_tasks);
+  printf("%-10s %15s %10s\n", "Threads", "Tasks/s", "Speed-up");
+
+  double single = 0;
+  for (size_t n_threads = 1; n_threads <= max_threads; n_threads *= 2) {
+    double rate = measure(n_tasks, n_threads);
+    if (n_threads == 1)
+      single = rate;
+    printf("%-10zu %15.0f %10.2f\n", n_threads, rate, rate / single);
+  }
+
+  return 0;
+}
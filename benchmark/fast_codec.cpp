@@ -0,0 +1,84 @@
+// Compares the fast codec with boost serialization for a vector of doubles, a
+// tuple of numbers and a short string. For each object, measures the time
+// taken to fingerprint it, as done when a task is created, and to store and
+// load it through the archive, as done with arguments and results.
+//
+// Usage: fast_codec.bin [number of doubles] [repetitions]
+
+#include "benchmark.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <tuple>
+#include <vector>
+
+using TaskDistribution::Fingerprint;
+using TaskDistribution::Key;
+
+// Runs the function the given number of times, returning the mean time in
+// microseconds.
+template <class F>
+double measure(size_t repetitions, F const& f) {
+  auto begin = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < repetitions; i++)
+    f();
+  auto end = std::chrono::steady_clock::now();
+
+  return std::chrono::duration<double, std::micro>(end - begin).count() /
+    repetitions;
+}
+
+template <class T>
+void compare(char const* name, T const& obj, size_t repetitions,
+    ObjectArchive<Key>& archive) {
+  Key key(0, 1, Key::Result);
+  T loaded;
+  TaskDistribution::ObjectCompressor compressor;
+
+  double boost_fingerprint = measure(repetitions,
+      [&]() { Fingerprint::of_object(obj); });
+  double fast_fingerprint = measure(repetitions, [&]() {
+      TaskDistribution::FingerprintHasher hasher;
+      TaskDistribution::fast_write(hasher, obj);
+      hasher.finish();
+    });
+
+  double boost_store = measure(repetitions, [&]() {
+      archive.insert(key, obj);
+      archive.load(key, loaded);
+    });
+  double fast_store = measure(repetitions, [&]() {
+      archive.insert_raw(key, TaskDistribution::serialize_object(obj));
+      TaskDistribution::load_object(archive, key, loaded, compressor);
+    });
+
+  if (!(loaded == obj))
+    printf("%s: object loaded differs\n", name);
+
+  printf("%-8s fingerprint %10.3f us (boost) %10.3f us (fast) %6.1fx\n",
+      name, boost_fingerprint, fast_fingerprint,
+      boost_fingerprint / fast_fingerprint);
+  printf("%-8s store+load  %10.3f us (boost) %10.3f us (fast) %6.1fx\n",
+      name, boost_store, fast_store, boost_store / fast_store);
+}
+
+int main(int argc, char* argv[]) {
+  size_t n_doubles = argc > 1 ? atol(argv[1]) : 1024*1024;
+  size_t repetitions = argc > 2 ? atol(argv[2]) : 100;
+
+  std::vector<double> vector(n_doubles);
+  for (size_t i = 0; i < n_doubles; i++)
+    vector[i] = i * 0.5;
+
+  std::tuple<int, double, size_t> tuple(1, 2.5, 3);
+  std::string string("a computing unit id");
+
+  TaskDistribution::BenchmarkArchive archive("fast_codec.archive");
+  compare("vector", vector, repetitions, archive.get());
+  compare("tuple", tuple, repetitions * 1000, archive.get());
+  compare("string", string, repetitions * 1000, archive.get());
+
+  return 0;
+}
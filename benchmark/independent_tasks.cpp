@@ -0,0 +1,37 @@
+// Measures how fast independent tasks are created. Every task is ready as soon
+// as it's created, so this stresses the ready queue.
+//
+// Usage: independent_tasks.bin [number of tasks]
+
+#include "benchmark.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+class Square: public TaskDistribution::ComputingUnit<Square> {
+  public:
+    Square(): ComputingUnit<Square>("square") {}
+
+    double operator()(double v) const {
+      return v * v;
+    }
+};
+
+int main(int argc, char* argv[]) {
+  size_t n_tasks = argc > 1 ? atol(argv[1]) : 1000000;
+
+  TaskDistribution::BenchmarkManager manager("independent_tasks.archive");
+  TaskDistribution::TaskManager& task_manager = manager.get();
+
+  auto begin = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < n_tasks; i++)
+    task_manager.new_task(Square(), (double)i);
+  auto end = std::chrono::steady_clock::now();
+
+  double elapsed = std::chrono::duration<double>(end - begin).count();
+  printf("%zu independent tasks created in %.3f s (%.0f tasks/s)\n", n_tasks,
+      elapsed, n_tasks / elapsed);
+
+  return 0;
+}
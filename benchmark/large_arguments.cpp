@@ -0,0 +1,75 @@
+// Measures the time taken by tasks that exchange large vectors. A vector with
+// 100 MB is created by a task, scaled by a second task, which takes it by value
+// and gives it back, and summed by a third task, so that copies of the
+// arguments and results dominate the time of each task.
+//
+// Usage: large_arguments.bin [number of doubles] [number of threads]
+
+#include "benchmark.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <numeric>
+#include <vector>
+
+class Create: public TaskDistribution::ComputingUnit<Create> {
+  public:
+    Create(): ComputingUnit<Create>("create") {}
+
+    std::vector<double> operator()(size_t n) const {
+      return std::vector<double>(n, 1.0);
+    }
+};
+
+class Scale: public TaskDistribution::ComputingUnit<Scale> {
+  public:
+    Scale(): ComputingUnit<Scale>("scale") {}
+
+    std::vector<double> operator()(std::vector<double> v, double f) const {
+      for (auto& it : v)
+        it *= f;
+      return v;
+    }
+};
+
+class Sum: public TaskDistribution::ComputingUnit<Sum> {
+  public:
+    Sum(): ComputingUnit<Sum>("sum") {}
+
+    double operator()(std::vector<double> const& v) const {
+      return std::accumulate(v.begin(), v.end(), 0.0);
+    }
+};
+
+int main(int argc, char* argv[]) {
+  size_t n_doubles = argc > 1 ? atol(argv[1]) : 100*1024*1024/sizeof(double);
+  size_t n_threads = argc > 2 ? atol(argv[2]) : 1;
+
+  TaskDistribution::BenchmarkManager manager("large_arguments.archive");
+  TaskDistribution::TaskManager& task_manager = manager.get();
+  task_manager.clear_task_begin_handler();
+  task_manager.clear_task_end_handler();
+  task_manager.set_number_of_threads(n_threads);
+
+  auto vector = task_manager.new_task(Create(), n_doubles);
+  auto scaled = task_manager.new_task(Scale(), vector, 2.0);
+  auto sum = task_manager.new_task(Sum(), scaled);
+
+  auto begin = std::chrono::steady_clock::now();
+  task_manager.run();
+  auto end = std::chrono::steady_clock::now();
+
+  double elapsed = std::chrono::duration<double>(end - begin).count();
+  printf("Vectors with %.0f MB computed in %.3f s (sum = %.0f)\n",
+      n_doubles * sizeof(double) / (1024.*1024), elapsed, (double)sum);
+
+  for (auto const& unit : {"create", "scale", "sum"}) {
+    TaskDistribution::UnitCost const* cost =
+      task_manager.get_cost_model().get(unit);
+    if (cost != nullptr)
+      printf("  %-8s %.3f s\n", unit, cost->mean_wall_time);
+  }
+
+  return 0;
+}
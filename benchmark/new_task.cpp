@@ -0,0 +1,85 @@
+// Measures how fast tasks are created, both when they are new and when they
+// already exist and must be found through their fingerprints. The graph is a
+// set of chains, so that each task has a task argument and a value argument.
+// The archive objects loaded and written for each task are also shown.
+//
+// Usage: new_task.bin [number of tasks] [chain length]
+
+#include "benchmark.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+class Sum: public TaskDistribution::ComputingUnit<Sum> {
+  public:
+    Sum(): ComputingUnit<Sum>("sum") {}
+
+    int operator()(int v1, int v2) const {
+      return v1 + v2;
+    }
+};
+
+void create_tasks(TaskDistribution::TaskManager& task_manager,
+    size_t n_tasks, size_t chain_length) {
+  TaskDistribution::Task<int> last;
+
+  for (size_t i = 0; i < n_tasks; i++) {
+    if (i % chain_length == 0)
+      last = task_manager.new_identity_task((int)(i / chain_length));
+    else
+      last = task_manager.new_task(Sum(), last, (int)i);
+  }
+}
+
+// Returns the tasks created per second and the archive operations done.
+double measure(TaskDistribution::TaskManager& task_manager, size_t n_tasks,
+    size_t chain_length, TaskDistribution::ArchiveOperations& operations) {
+  TaskDistribution::ArchiveOperations before =
+    task_manager.get_creation_operations();
+
+  auto begin = std::chrono::steady_clock::now();
+  create_tasks(task_manager, n_tasks, chain_length);
+  task_manager.flush_family_lists();
+  auto end = std::chrono::steady_clock::now();
+
+  operations = task_manager.get_creation_operations();
+  operations.n_loads -= before.n_loads;
+  operations.n_inserts -= before.n_inserts;
+  operations.n_writes -= before.n_writes;
+
+  return n_tasks / std::chrono::duration<double>(end - begin).count();
+}
+
+void run(bool trust_fingerprints, size_t n_tasks, size_t chain_length) {
+  TaskDistribution::BenchmarkManager manager("new_task.archive");
+  TaskDistribution::TaskManager& task_manager = manager.get();
+  task_manager.set_trust_fingerprints(trust_fingerprints);
+
+  TaskDistribution::ArchiveOperations created_operations, found_operations;
+  double created = measure(task_manager, n_tasks, chain_length,
+      created_operations);
+  double found = measure(task_manager, n_tasks, chain_length,
+      found_operations);
+
+  printf("%-20s %15.0f %15.0f %7.2f/%-7.2f %7.2f/%-7.2f\n",
+      trust_fingerprints ? "trust fingerprints" : "compare bytes",
+      created, found,
+      double(created_operations.n_loads) / n_tasks,
+      double(created_operations.n_writes) / n_tasks,
+      double(found_operations.n_loads) / n_tasks,
+      double(found_operations.n_writes) / n_tasks);
+}
+
+int main(int argc, char* argv[]) {
+  size_t n_tasks = argc > 1 ? atol(argv[1]) : 100000;
+  size_t chain_length = argc > 2 ? atol(argv[2]) : 100;
+
+  printf("%zu tasks in chains of %zu\n\n", n_tasks, chain_length);
+  printf("%-20s %15s %15s %15s %15s\n", "Mode", "New (tasks/s)",
+      "Found (tasks/s)", "New (ld/wr)", "Found (ld/wr)");
+  run(false, n_tasks, chain_length);
+  run(true, n_tasks, chain_length);
+
+  return 0;
+}
@@ -0,0 +1,48 @@
+// Measures the creation of a task with many children, whose children list used
+// to be loaded and stored again for each new child.
+//
+// Usage: wide_graph.bin [number of children]
+
+#include "benchmark.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+class Sum: public TaskDistribution::ComputingUnit<Sum> {
+  public:
+    Sum(): ComputingUnit<Sum>("sum") {}
+
+    int operator()(int v1, int v2) const {
+      return v1 + v2;
+    }
+};
+
+int main(int argc, char* argv[]) {
+  size_t n_children = argc > 1 ? atol(argv[1]) : 1000000;
+
+  TaskDistribution::BenchmarkManager manager("wide_graph.archive");
+  TaskDistribution::TaskManager& task_manager = manager.get();
+
+  auto begin = std::chrono::steady_clock::now();
+
+  TaskDistribution::Task<int> parent = task_manager.new_identity_task(0);
+  for (size_t i = 0; i < n_children; i++)
+    task_manager.new_task(Sum(), parent, (int)i);
+
+  auto created = std::chrono::steady_clock::now();
+
+  task_manager.flush_family_lists();
+
+  auto end = std::chrono::steady_clock::now();
+
+  double creation = std::chrono::duration<double>(created - begin).count();
+  double flush = std::chrono::duration<double>(end - created).count();
+
+  printf("%zu children of a single task\n\n", n_children);
+  printf("Creation: %.3f s (%.0f tasks/s)\n", creation,
+      n_children / creation);
+  printf("Flush:    %.3f s\n", flush);
+
+  return 0;
+}
@@ -0,0 +1,152 @@
+// Creating a task loads and stores several objects of the archive: its entry,
+// its parents list and the entries of its parents, whose children lists are
+// stored later. This file defines a batch that buffers these writes, so that
+// they are done together when the batch is committed.
+//
+// Objects loaded through the batch are copied, so that an object stored again
+// without changes, as happens when tasks already in the archive are created
+// again, isn't written. Objects inserted many times are written once, and
+// loading them gives the pending object, so that the batch sees its own
+// changes.
+//
+// The batch also counts the archive operations, which are summed by the task
+// manager so that the operations per task created are known.
+//
+// The batch isn't synchronized and must be used while holding the archive
+// mutex. Nothing is written if it's destroyed without being committed.
+
+#ifndef __TASK_DISTRIBUTION__ARCHIVE_BATCH_HPP__
+#define __TASK_DISTRIBUTION__ARCHIVE_BATCH_HPP__
+
+#include "object_archive.hpp"
+
+#include <boost/assert.hpp>
+#include <memory>
+#include <typeindex>
+#include <unordered_map>
+#include <vector>
+
+#include "key.hpp"
+
+namespace TaskDistribution {
+  struct ArchiveOperations {
+    size_t n_loads;   // Objects loaded from the archive
+    size_t n_inserts; // Objects given to be stored
+    size_t n_writes;  // Objects actually stored
+
+    ArchiveOperations():
+      n_loads(0),
+      n_inserts(0),
+      n_writes(0) { }
+
+    ArchiveOperations& operator+=(ArchiveOperations const& other);
+  };
+
+  class ArchiveBatch {
+    public:
+      explicit ArchiveBatch(ObjectArchive<Key>& archive);
+
+      // Loads the object with the given key, which is the pending one if it
+      // was inserted in the batch. obj is unchanged if there's no such object.
+      // Each key must always be used with the same type.
+      template <class T>
+      void load(Key const& key, T& obj);
+
+      // Schedules the object to be stored with the given key when the batch is
+      // committed, replacing any object pending with the same key. T must
+      // have operator==.
+      template <class T>
+      void insert(Key const& key, T const& obj);
+
+      // Stores the pending objects that changed, in the order they were first
+      // inserted, and empties the batch.
+      void commit();
+
+      ArchiveOperations const& get_operations() const;
+
+    private:
+      struct Entry {
+        std::shared_ptr<void const> loaded;  // As in the archive, if loaded
+        std::shared_ptr<void const> pending; // To be stored, if changed
+        std::type_index type;
+        bool inserted;
+        void (*write)(ObjectArchive<Key>&, Key const&, void const*);
+      };
+
+      template <class T>
+      static void write_object(ObjectArchive<Key>& archive, Key const& key,
+          void const* obj);
+
+      // Finds the entry with the given key, adding it if needed.
+      template <class T>
+      Entry& get_entry(Key const& key);
+
+      ObjectArchive<Key>& archive_;
+      std::unordered_map<Key, Entry> entries_;
+
+      // Keys inserted, in the order they were first inserted.
+      std::vector<Key> order_;
+
+      ArchiveOperations operations_;
+  };
+
+  template <class T>
+  void ArchiveBatch::load(Key const& key, T& obj) {
+    Entry& entry = get_entry<T>(key);
+
+    if (entry.pending) {
+      obj = *static_cast<T const*>(entry.pending.get());
+      return;
+    }
+
+    if (entry.loaded) {
+      obj = *static_cast<T const*>(entry.loaded.get());
+      return;
+    }
+
+    operations_.n_loads++;
+    if (!archive_.is_available(key))
+      return;
+
+    archive_.load(key, obj);
+    entry.loaded = std::make_shared<T const>(obj);
+  }
+
+  template <class T>
+  void ArchiveBatch::insert(Key const& key, T const& obj) {
+    Entry& entry = get_entry<T>(key);
+    operations_.n_inserts++;
+
+    if (entry.loaded && *static_cast<T const*>(entry.loaded.get()) == obj) {
+      entry.pending.reset();
+      return;
+    }
+
+    if (!entry.inserted) {
+      order_.push_back(key);
+      entry.inserted = true;
+    }
+
+    entry.pending = std::make_shared<T const>(obj);
+  }
+
+  template <class T>
+  void ArchiveBatch::write_object(ObjectArchive<Key>& archive,
+      Key const& key, void const* obj) {
+    archive.insert(key, *static_cast<T const*>(obj));
+  }
+
+  template <class T>
+  ArchiveBatch::Entry& ArchiveBatch::get_entry(Key const& key) {
+    auto it = entries_.find(key);
+    if (it == entries_.end())
+      it = entries_.emplace(key, Entry({nullptr, nullptr,
+              std::type_index(typeid(T)), false, &write_object<T>})).first;
+
+    BOOST_ASSERT_MSG(it->second.type == typeid(T),
+        "object used with another type");
+    return it->second;
+  }
+};
+
+#endif
@@ -0,0 +1,138 @@
+// Results must be stored in the archive, but the tasks that use them usually
+// run in the same process right after. This file defines a writer that stores
+// objects in the archive from another thread, so that serializing and writing a
+// result doesn't delay the next computations.
+//
+// The objects are shared with the writer, which serializes them without any
+// lock and only holds the archive mutex while inserting the serialized string.
+// Until then, the objects are kept as pending and can be copied from the writer
+// by their keys, as the archive doesn't have them yet. Objects are written in
+// the order they were inserted, and an object inserted with a key still
+// pending replaces the older one.
+//
+// The total estimated size of pending objects is bounded, so that inserting
+// waits for older objects to be written if the bound would be passed. A single
+// object is always accepted. The sizes are estimated with object_size() without
+// serializing, so types estimated by their serialization only count sizeof(T)
+// until written.
+
+#ifndef __TASK_DISTRIBUTION__ARCHIVE_WRITER_HPP__
+#define __TASK_DISTRIBUTION__ARCHIVE_WRITER_HPP__
+
+#include "object_archive.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <typeindex>
+#include <unordered_map>
+
+#include "fast_codec.hpp"
+#include "key.hpp"
+#include "result_cache.hpp"
+
+namespace TaskDistribution {
+  class ArchiveWriter {
+    public:
+      // The bound on pending objects is given in bytes.
+      ArchiveWriter(ObjectArchive<Key>& archive,
+          std::recursive_mutex& archive_mutex,
+          size_t max_pending_size = 256*1024*1024);
+
+      // Writes every pending object before finishing.
+      ~ArchiveWriter();
+
+      // Schedules the object to be stored with the given key. The object must
+      // not be changed afterwards. Must not be called while holding the
+      // archive mutex, as it may wait for other objects to be written.
+      template <class T>
+      void insert(Key const& key, std::shared_ptr<T const> const& obj);
+
+      // Same, but the object is serialized by the given function and its
+      // size is given already estimated, as for the result cache.
+      template <class T>
+      void insert(Key const& key, std::shared_ptr<T const> const& obj,
+          std::function<std::string()> const& serialize, size_t size);
+
+      // Copies the pending object with the given key to ret. Returns false if
+      // it isn't pending with the type T.
+      template <class T>
+      bool get(Key const& key, T& ret);
+
+      // Shares the pending object with the given key without copying it.
+      // Returns nullptr if it isn't pending with the type T.
+      template <class T>
+      std::shared_ptr<T const> get_shared(Key const& key);
+
+      // Waits until every pending object is written. Must not be called while
+      // holding the archive mutex.
+      void flush();
+
+    private:
+      struct Entry {
+        std::shared_ptr<void const> object;
+        std::type_index type;
+        size_t size;
+        std::function<std::string()> serialize;
+      };
+
+      // Adds the entry to the queue, starting the thread if needed.
+      void insert_entry(Key const& key, Entry const& entry);
+
+      // Body of the thread that writes the entries.
+      void run();
+
+      ObjectArchive<Key>& archive_;
+      std::recursive_mutex& archive_mutex_;
+      size_t max_pending_size_;
+
+      // Protects the following members.
+      std::mutex mutex_;
+      std::condition_variable condition_;
+
+      std::unordered_map<Key, Entry> pending_;
+      std::deque<Key> queue_;
+      size_t pending_size_;
+      bool stop_;
+      std::thread thread_;
+  };
+
+  template <class T>
+  void ArchiveWriter::insert(Key const& key,
+      std::shared_ptr<T const> const& obj) {
+    insert(key, obj, [obj]() { return serialize_object(*obj); },
+        object_size(*obj, 0));
+  }
+
+  template <class T>
+  void ArchiveWriter::insert(Key const& key,
+      std::shared_ptr<T const> const& obj,
+      std::function<std::string()> const& serialize, size_t size) {
+    insert_entry(key, Entry({obj, std::type_index(typeid(T)), size,
+          serialize}));
+  }
+
+  template <class T>
+  bool ArchiveWriter::get(Key const& key, T& ret) {
+    std::shared_ptr<T const> object = get_shared<T>(key);
+    if (!object)
+      return false;
+
+    ret = *object;
+    return true;
+  }
+
+  template <class T>
+  std::shared_ptr<T const> ArchiveWriter::get_shared(Key const& key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = pending_.find(key);
+    if (it == pending_.end() || it->second.type != typeid(T))
+      return nullptr;
+    return std::static_pointer_cast<T const>(it->second.object);
+  }
+};
+
+#endif
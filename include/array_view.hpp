@@ -0,0 +1,62 @@
+// Results that are large vectors are usually only read after they are
+// computed, but converting a task to its result copies the values into a new
+// vector, besides the copy kept by the result cache. This file defines a
+// read-only view of contiguous values, which is given by Task::view() instead.
+//
+// The view shares the memory that holds the values, which may be the bytes
+// loaded from the archive or a result kept in memory by the manager, and keeps
+// it alive while the view or any copy of it exists. Copying the view doesn't
+// copy the values. Values loaded from the archive are still copied once from
+// it into these bytes, as the archive only gives copies of the stored objects,
+// but aren't decoded into a vector.
+
+#ifndef __TASK_DISTRIBUTION__ARRAY_VIEW_HPP__
+#define __TASK_DISTRIBUTION__ARRAY_VIEW_HPP__
+
+#include <boost/assert.hpp>
+#include <memory>
+#include <vector>
+
+namespace TaskDistribution {
+  template <class T>
+  class ArrayView {
+    public:
+      typedef T value_type;
+      typedef size_t size_type;
+      typedef T const* iterator;
+      typedef T const* const_iterator;
+
+      ArrayView(): data_(nullptr), size_(0) { }
+
+      // Views the values, which must live while owner does.
+      ArrayView(std::shared_ptr<void const> const& owner, T const* data,
+          size_t size):
+        owner_(owner),
+        data_(data),
+        size_(size) { }
+
+      T const* data() const { return data_; }
+      size_t size() const { return size_; }
+      bool empty() const { return size_ == 0; }
+
+      iterator begin() const { return data_; }
+      iterator end() const { return data_ + size_; }
+
+      T const& operator[](size_t i) const {
+        BOOST_ASSERT_MSG(i < size_, "index out of the view");
+        return data_[i];
+      }
+
+      // Copies the values to a new vector.
+      std::vector<T> to_vector() const {
+        return std::vector<T>(begin(), end());
+      }
+
+    private:
+      std::shared_ptr<void const> owner_;
+      T const* data_;
+      size_t size_;
+  };
+};
+
+#endif
@@ -0,0 +1,104 @@
+// Large results and arguments, usually arrays of numbers, take most of the
+// archive and of the messages between nodes. This file defines the compression
+// applied to these objects when they are stored.
+//
+// The compressor is a small LZ77 variant in the spirit of LZ4, kept here so
+// that no external library is required. The data is a sequence of literals and
+// matches of at least 4 bytes found in the previous 64 KiB, found through a
+// hash table of 4-byte sequences. Data that doesn't match is skipped faster as
+// more bytes don't match, so incompressible objects cost little time.
+//
+// Compressed objects start with a header and their original size, so that they
+// are told apart from other objects and decompressed before being decoded.
+// Objects that don't shrink by at least 1/8 are stored as they were. Objects
+// serialized through boost are compressed as well, so every object that may be
+// compressed is loaded as raw bytes, decompressed and then decoded. Task
+// entries are never compressed, as they are updated in place in the archive.
+//
+// Objects are compressed if their encoding has at least the threshold set for
+// the unit of the task that stores them, or the default threshold. Identity
+// tasks use the unit id "identity". Compression is disabled by default. The
+// thresholds must be set before tasks are created, while the statistics may be
+// updated by many threads.
+//
+// With MPI, each process compresses the results it computes with its own
+// compressor. The thresholds set in the master are given to the slaves when
+// the tasks are run, and the statistics of every process are summed in the
+// master afterwards.
+
+#ifndef __TASK_DISTRIBUTION__COMPRESSION_HPP__
+#define __TASK_DISTRIBUTION__COMPRESSION_HPP__
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <unordered_map>
+
+namespace TaskDistribution {
+  // Compresses the size bytes of data with the LZ variant, appending them to
+  // out.
+  void lz_compress(char const* data, size_t size, std::string& out);
+
+  // Decompresses the size bytes of data into the out_size bytes of out.
+  // Returns false if the data is corrupt or doesn't fill out exactly.
+  bool lz_decompress(char const* data, size_t size, char* out,
+      size_t out_size);
+
+  class ObjectCompressor {
+    public:
+      // Threshold that disables compression.
+      static size_t const never = std::numeric_limits<size_t>::max();
+
+      // Times are in seconds.
+      struct Statistics {
+        size_t n_compressed;      // Objects compressed
+        size_t n_incompressible;  // Objects stored as they were
+        size_t original_size;     // Bytes of the objects compressed
+        size_t compressed_size;   // And after compression
+        double compression_time;  // Including incompressible objects
+        size_t n_decompressed;
+        double decompression_time;
+      };
+
+      ObjectCompressor();
+
+      // Sets the smallest encoding compressed for units without their own
+      // threshold.
+      void set_threshold(size_t threshold);
+      size_t get_threshold() const;
+
+      // Sets the smallest encoding compressed for the unit with the given id.
+      void set_unit_threshold(std::string const& unit_id, size_t threshold);
+      size_t get_unit_threshold(std::string const& unit_id) const;
+
+      // Thresholds set for units, by unit id.
+      std::unordered_map<std::string, size_t> const&
+      get_unit_thresholds() const;
+
+      // Compresses the object's encoding in place if it reaches the unit's
+      // threshold and shrinks enough. Returns whether it was compressed.
+      bool compress(std::string& data_str, std::string const& unit_id);
+
+      // Decompresses the object in place if it was compressed. Throws
+      // std::runtime_error if it's corrupt.
+      bool decompress(std::string& data_str);
+
+      static bool is_compressed(std::string const& data_str);
+
+      Statistics get_statistics() const;
+
+    private:
+      size_t threshold_;
+      std::unordered_map<std::string, size_t> unit_thresholds_;
+
+      std::atomic<size_t> n_compressed_, n_incompressible_;
+      std::atomic<size_t> original_size_, compressed_size_;
+      std::atomic<size_t> n_decompressed_;
+
+      // In nanoseconds.
+      std::atomic<uint64_t> compression_time_, decompression_time_;
+  };
+};
+
+#endif
@@ -23,7 +23,8 @@
 // 2) All arguments and the return of operator() must be serializable through
 // boost;
 // 3) operator() must be declared as const, to ensure no modifications are
-// performed.
+// performed. The same object is used by every task with equal units and may be
+// called by many threads at the same time.
 //
 // Besides these requirements, the user has control over whether the object must
 // run on the master node, chosen through the method "run_locally()". This
@@ -31,6 +32,12 @@
 // the operator() method is so fast that the communication overhead isn't worth.
 // The unit is allowed to run anywhere by default.
 //
+// Units are kept in a registry that may be used by many threads. Each unit
+// registered has a dense index, and keys to unit ids are bound to the index
+// once, so that finding the unit of a task doesn't depend on its id. Lookups
+// never lock: the registry is replaced by a new copy when a unit or key is
+// added, which happens only the first time each one is seen.
+//
 // For an example of how to implement an unit, check code on
 // example/example.cpp.
 
@@ -41,11 +48,13 @@
 #include "object_archive.hpp"
 #include "sequence.hpp"
 
+#include <functional>
+#include <string>
 #include <tuple>
 #include <type_traits>
-#include <unordered_map>
 
 #include "computing_unit_manager.hpp"
+#include "cost_model.hpp"
 #include "key.hpp"
 #include "task_entry.hpp"
 
@@ -67,6 +76,10 @@ namespace TaskDistribution {
       // if not found.
       static BaseComputingUnit const* get_by_key(Key const& key);
 
+      // Static method to fetch the unit with the given index. Returns NULL if
+      // not found.
+      static BaseComputingUnit const* get_by_index(size_t index);
+
       // Binds a given id with a key. Multiple keys may be bound to the same id.
       // Returns true if the id was found.
       static bool bind_key(std::string const& id, Key const& key);
@@ -76,6 +89,12 @@ namespace TaskDistribution {
         return *id_;
       }
 
+      // Gets the index associated with this kind of unit. Indexes are given in
+      // the order units are registered, starting from 0.
+      size_t get_index() const {
+        return index_;
+      }
+
       // Provides an invalid unit id.
       static std::string get_invalid_id() {
         return "";
@@ -86,26 +105,53 @@ namespace TaskDistribution {
       template<class Archive>
       void serialize(Archive& ar, const unsigned int version) { }
 
-      // Loads the computing unit and arguments and stores the result in the
-      // archive. Assumes every Key provided is valid.
+      // Loads the computing unit and arguments and stores the result, setting
+      // it in the task's entry. Assumes every Key provided is valid. The
+      // archive is accessed only while holding the manager's archive mutex.
+      // The times taken by the computation alone are given in cost.
       virtual void execute(ObjectArchive<Key>& archive,
-          TaskEntry const& task, ComputingUnitManager& manager) const = 0;
+          TaskEntry& task, ComputingUnitManager& manager,
+          TaskCost& cost) const = 0;
 
     protected:
-      // Expands the tuple and calls the functor
+      // Expands the tuple and calls the functor. The arguments are moved into
+      // the call, except the ones taken by non-const reference.
       template <class F, class Tuple, size_t... S>
       static typename CompileUtils::function_traits<F>::return_type
-      apply(F&& f, Tuple&& args, CompileUtils::sequence<S...>) {
-        return std::forward<F>(f)(std::get<S>(std::forward<Tuple>(args))...);
+      apply(F&& f, Tuple& args, CompileUtils::sequence<S...>) {
+        typedef typename CompileUtils::function_traits<F>::arg_tuple_type
+          params_type;
+        return std::forward<F>(f)(forward_argument<
+            typename std::tuple_element<S, params_type>::type>(
+              std::get<S>(args))...);
       }
 
+      // Type used to give an argument to the parameter: an rvalue, unless the
+      // parameter is a non-const lvalue reference.
+      template <class Param, class Arg>
+      struct forwarded_argument {
+        typedef typename std::conditional<
+          std::is_lvalue_reference<Param>::value &&
+          !std::is_const<typename std::remove_reference<Param>::type>::value,
+          Arg&, Arg&&>::type type;
+      };
+
+      template <class Param, class Arg>
+      static typename forwarded_argument<Param, Arg>::type
+      forward_argument(Arg& arg) {
+        return static_cast<typename forwarded_argument<Param, Arg>::type>(arg);
+      }
+
+      // Registers the unit created by the function if no unit with the same id
+      // exists. Returns the unit registered with the id.
+      static BaseComputingUnit const* register_unit(std::string const& id,
+          std::function<BaseComputingUnit*()> const& create);
+
       // Name of the computing unit given at construction
       std::string const* id_;
 
-      // Map between ids and units.
-      static std::unordered_map<std::string,BaseComputingUnit const*> id_map_;
-      // Map between keys and units.
-      static std::unordered_map<Key,BaseComputingUnit const*> key_map_;
+      // Index of the computing unit in the registry
+      size_t index_;
   };
 
   // Class that should be inherited by the user's units. For an example on how
@@ -115,11 +161,12 @@ namespace TaskDistribution {
   template <class T>
   class ComputingUnit: public BaseComputingUnit {
     public:
-      // Registers the unit by placing a new copy into the units' map.
+      // Registers the unit by placing a new copy into the registry.
       explicit ComputingUnit(std::string const& name);
 
       virtual void execute(ObjectArchive<Key>& archive,
-          TaskEntry const& task, ComputingUnitManager& manager) const;
+          TaskEntry& task, ComputingUnitManager& manager,
+          TaskCost& cost) const;
 
     private:
       // Internal constructor to avoid deadlock during unit register.
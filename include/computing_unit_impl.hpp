@@ -6,22 +6,42 @@
 
 #include "computing_unit.hpp"
 
+#include "fast_codec.hpp"
+#include "partial_tuple.hpp"
 #include "tuple_serialize.hpp"
 
 #include <functional>
+#include <memory>
+#include <mutex>
 
 namespace TaskDistribution {
   template <class T>
   ComputingUnit<T>::ComputingUnit(std::string const& name) {
     // If we don't already have this kind of Callable, create a copy to store at
-    // the map, so this one can be freed whenever the user chooses.
-    if (id_map_.find(name) == id_map_.end()) {
-      ComputingUnit<T>* unit = new ComputingUnit<T>();
-      auto it = id_map_.emplace(name, unit).first;
-      id_ = &it->first;
-      unit->id_ = id_;
+    // the registry, so this one can be freed whenever the user chooses.
+    BaseComputingUnit const* unit = register_unit(name,
+        []() -> BaseComputingUnit* { return new ComputingUnit<T>(); });
+    id_ = &unit->get_id();
+    index_ = unit->get_index();
+  }
+
+  template <size_t I, class Tuple>
+  typename std::enable_if<(I == std::tuple_size<Tuple>::value), void>::type
+  compute_missing_parents(Tuple const&, ComputingUnitManager&) { }
+
+  template <size_t I, class Tuple>
+  typename std::enable_if<(I < std::tuple_size<Tuple>::value), void>::type
+  compute_missing_parents(Tuple const& tasks, ComputingUnitManager& manager) {
+    Key const& task_key = std::get<I>(tasks);
+    if (task_key.is_valid()) {
+      TaskEntry entry;
+      manager.load_entry(task_key, entry);
+
+      if (!entry.has_result())
+        manager.process_local(entry);
     }
-    id_ = &id_map_.find(name)->first;
+
+    compute_missing_parents<I + 1>(tasks, manager);
   }
 
   template <size_t I, class To, class From>
@@ -38,23 +58,10 @@ namespace TaskDistribution {
     Key const& task_key = std::get<I>(from);
     if (task_key.is_valid()) {
       TaskEntry entry;
-      archive.load(task_key, entry);
+      manager.load_entry(task_key, entry);
 
-      // If key is invalid, then compute locally the result and store at the
-      // invalid position
-      if (!entry.result_key.is_valid())
-        manager.process_local(entry);
-
-      // Loads result even is key is invalid, as it contains the temporary
-      // result
-      typename std::tuple_element<I, To>::type result;
-      archive.load(entry.result_key, result);
-
-      // Removes the result if it was used only temporarily
-      if (!entry.result_key.is_valid())
-        archive.remove(entry.result_key);
-
-      std::get<I>(to) = result;
+      // Loads the result directly into the argument's position
+      manager.load_result(entry, std::get<I>(to));
     }
 
     load_tasks_arguments_detail<I + 1>(to, from, archive, manager);
@@ -70,36 +77,56 @@ namespace TaskDistribution {
 
   template <class T>
   void ComputingUnit<T>::execute(ObjectArchive<Key>& archive,
-      TaskEntry const& task, ComputingUnitManager& manager) const {
-    // Loads computing unit
-    T obj;
-    if (task.computing_unit_key.is_valid())
-      archive.load(task.computing_unit_key, obj);
+      TaskEntry& task, ComputingUnitManager& manager, TaskCost& cost) const {
+    std::unique_lock<std::recursive_mutex> lock(manager.get_archive_mutex());
+
+    // Loads computing unit, which is shared with other tasks
+    std::shared_ptr<T const> obj(
+        manager.load_unit<T>(task.computing_unit_key));
+
+    // Loads tasks arguments' keys, which tell which arguments were stored
+    typedef typename CompileUtils::clean_tuple_from_tuple<
+      typename CompileUtils::function_traits<T>::arg_tuple_type>::type
+      args_tuple_type;
+    typename CompileUtils::repeated_tuple<
+      std::tuple_size<args_tuple_type>::value, Key>::type tasks_tuple;
+    if (task.arguments_tasks_key.is_valid())
+      load_object(archive, task.arguments_tasks_key, tasks_tuple,
+          manager.get_compressor());
+
+    // Parents without result are computed first without holding the archive,
+    // as storing their results may wait for the writer thread, which needs it
+    lock.unlock();
+    compute_missing_parents<0>(tasks_tuple, manager);
+    lock.lock();
 
     // Loads arguments
-    typename CompileUtils::clean_tuple_from_tuple<
-      typename CompileUtils::function_traits<T>::arg_tuple_type>::type args;
-    if (task.arguments_key.is_valid())
-      archive.load(task.arguments_key, args);
-
-    // Loads tasks arguments
-    if (task.arguments_tasks_key.is_valid()) {
-      typename CompileUtils::repeated_tuple<
-        std::tuple_size<decltype(args)>::value, Key>::type tasks_tuple;
-      archive.load(task.arguments_tasks_key, tasks_tuple);
-
-      load_tasks_arguments(args, tasks_tuple, archive, manager);
+    args_tuple_type args;
+    if (task.arguments_key.is_valid()) {
+      PartialTuple<args_tuple_type> partial_args(args,
+          PartialTuple<args_tuple_type>::make_mask(tasks_tuple));
+      load_object(archive, task.arguments_key, partial_args,
+          manager.get_compressor());
     }
 
-    // Performs the computation
-    typename CompileUtils::function_traits<T>::return_type res(
-      apply(obj, args,
-        typename CompileUtils::sequence_generator<
-        CompileUtils::function_traits<T>::arity>::type()));
-
-    // Stores result, even if result_key.is_valid() == false, as it will be used
-    // later
-    archive.insert(task.result_key, res);
+    // Loads tasks arguments
+    load_tasks_arguments(args, tasks_tuple, archive, manager);
+
+    // Performs the computation without holding the archive. The arguments
+    // aren't used afterwards, so they are moved into the call and the result
+    // is moved into the shared object. Only this is timed.
+    lock.unlock();
+    typedef typename CompileUtils::function_traits<T>::return_type
+      return_type;
+    CostTimer timer;
+    std::shared_ptr<return_type const> res(
+        std::make_shared<return_type const>(apply(*obj, args,
+            typename CompileUtils::sequence_generator<
+            CompileUtils::function_traits<T>::arity>::type())));
+    cost = timer.elapsed();
+
+    // Shares the result with the tasks that use it in this process
+    manager.store_result(task, res, get_id());
   }
 };
 
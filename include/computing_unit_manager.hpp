@@ -3,8 +3,37 @@
 //
 // If the computation must be performed locally, the method "process_local" must
 // be called with the task. The manager then will find the correct computing
-// unit, create a new key for the result and execute the computation, which will
-// load the data and store the result.
+// unit and execute the computation, which will load the data and store the
+// result, either inline in the task's entry or with a new key.
+//
+// Tasks may be processed locally by many threads at the same time. Every access
+// to the archive must be done while holding the mutex given by
+// "get_archive_mutex", which is recursive so that the manager's methods may be
+// called while holding it. A computing unit computes its missing arguments
+// before taking it, as results must not be stored while holding it.
+//
+// The wall and CPU times of the computation of each task processed locally,
+// without loading its arguments or storing its result, are measured by the
+// computing unit and added to the cost model of the unit.
+//
+// Results should be loaded through "load_result", which keeps the deserialized
+// results in a cache, so that a result used by many tasks is only loaded once.
+// Results computed are stored through "store_result", which shares the object
+// with the cache, so that tasks run later in the same process use it without
+// deserializing it. Results that are vectors of numbers may also be viewed
+// through "load_result_view", which doesn't decode them. By default, the
+// result is then written to the archive by another thread, and
+// "flush_results" must be called before the archive is accessed without the
+// manager. Large results may be compressed by the manager's compressor, with
+// the threshold of the unit that computed them.
+//
+// With asynchronous writes, the entry of a task processed is also written by
+// the other thread, after its result, so that the archive never has an entry
+// whose result is missing. Until then, it's found through "load_entry".
+//
+// Computing units are also loaded through the manager, which keeps one object
+// for each key, shared by every task that uses the unit. As operator() is
+// const, the same object may be used by many threads at the same time.
 //
 // For remote operation, see the file computing_unit_manager_mpi.hpp.
 
@@ -12,24 +41,128 @@
 #define __TASK_DISTRIBUTION__COMPUTING_UNIT_MANAGER_HPP__
 
 #include "object_archive.hpp"
+#include "archive_writer.hpp"
+#include "array_view.hpp"
+#include "compression.hpp"
+#include "cost_model.hpp"
+#include "fast_codec.hpp"
 #include "key.hpp"
+#include "result_cache.hpp"
 #include "task_entry.hpp"
 
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
 namespace TaskDistribution {
+  class BaseComputingUnit;
+
   class ComputingUnitManager {
     public:
       ComputingUnitManager(ObjectArchive<Key>& archive);
 
+      virtual ~ComputingUnitManager();
+
       // Processes the task locally, so that loading task.result gives the
-      // result.
-      void process_local(TaskEntry& task);
+      // result. The task's unit is found by its key if it isn't given.
+      void process_local(TaskEntry& task,
+          BaseComputingUnit const* unit = nullptr);
+
+      // Loads the entry of the task, which may still be waiting to be written
+      // after its result. Entries must be loaded through this while tasks
+      // run.
+      void load_entry(Key const& task_key, TaskEntry& entry);
+
+      // Mutex that must be held while accessing the archive.
+      std::recursive_mutex& get_archive_mutex();
+
+      // Model of the time taken by the tasks processed. It must only be used
+      // while holding the archive mutex if tasks may be running.
+      CostModel& get_cost_model();
+      CostModel const& get_cost_model() const;
+
+      // Loads the result with the given key, using the cache if possible.
+      template <class T>
+      void load_result(Key const& result_key, T& ret);
+
+      // Loads the result of the task, which may be inline in its entry.
+      template <class T>
+      void load_result(TaskEntry const& task, T& ret);
+
+      // Views the result with the given key, which is a std::vector<T>,
+      // without decoding it. Results kept in memory are shared, and results
+      // encoded by the fast codec are viewed in the bytes loaded from the
+      // archive, which copies them once but doesn't build a vector. The view
+      // isn't kept in the cache.
+      template <class T>
+      void load_result_view(Key const& result_key, ArrayView<T>& view);
+
+      // Stores the result with the given key, which must not be changed
+      // afterwards, computed by the unit with the given id. Must not be
+      // called while holding the archive mutex.
+      template <class T>
+      void store_result(Key const& result_key,
+          std::shared_ptr<T const> const& result,
+          std::string const& unit_id = std::string());
+
+      // Stores the result of the task inline in its entry if possible or with
+      // a new result key otherwise. Must not be called while holding the
+      // archive mutex.
+      template <class T>
+      void store_result(TaskEntry& task,
+          std::shared_ptr<T const> const& result,
+          std::string const& unit_id = std::string());
+
+      // Loads the computing unit with the given key, which is kept for the next
+      // tasks. If the key is invalid, a new default unit is given.
+      template <class T>
+      std::shared_ptr<T const> load_unit(Key const& unit_key);
+
+      // Removes the computing units loaded. This must be done if keys are
+      // changed.
+      void clear_units();
+
+      // Whether results are written to the archive by another thread.
+      // Defaults to true.
+      void set_asynchronous_writes(bool asynchronous_writes);
+      bool get_asynchronous_writes() const;
+
+      // Waits until every result is written to the archive. Must not be
+      // called while holding the archive mutex.
+      void flush_results();
+
+      // Cache of results loaded. It must only be used while holding the
+      // archive mutex if tasks may be running.
+      ResultCache& get_result_cache();
+      ResultCache const& get_result_cache() const;
+
+      // Compressor of large objects, used for every object stored or loaded
+      // through the managers.
+      ObjectCompressor& get_compressor();
+      ObjectCompressor const& get_compressor() const;
 
     private:
+      // Serializes the result, compressing it if it's large enough. The size
+      // of the serialization before compression is given in serialized_size.
+      template <class T>
+      std::string serialize_result(T const& result,
+          std::string const& unit_id, size_t& serialized_size);
+
       // Creates a new key of the given type.
       virtual Key new_key(Key::Type type);
 
       ObjectArchive<Key>& archive_;
+      std::recursive_mutex archive_mutex_;
+      CostModel cost_model_;
+      ResultCache result_cache_;
+      // The writer uses the compressor until it's destroyed
+      ObjectCompressor compressor_;
+      ArchiveWriter writer_;
+      std::unordered_map<Key, std::shared_ptr<void const>> units_;
+      bool asynchronous_writes_;
   };
 };
 
+#include "computing_unit_manager_impl.hpp"
+
 #endif
@@ -0,0 +1,147 @@
+#ifndef __TASK_DISTRIBUTION__COMPUTING_UNIT_MANAGER_IMPL_HPP__
+#define __TASK_DISTRIBUTION__COMPUTING_UNIT_MANAGER_IMPL_HPP__
+
+#include "computing_unit_manager.hpp"
+
+namespace TaskDistribution {
+  template <class T>
+  void ComputingUnitManager::load_result(Key const& result_key, T& ret) {
+    std::lock_guard<std::recursive_mutex> lock(archive_mutex_);
+
+    if (result_cache_.get(result_key, ret))
+      return;
+
+    // The result may still be waiting to be written, in which case it was
+    // cached when stored and is only copied again
+    if (writer_.get(result_key, ret))
+      return;
+
+    size_t serialized_size = load_object(archive_, result_key, ret,
+        compressor_);
+    result_cache_.insert(result_key, ret, object_size(ret, serialized_size));
+  }
+
+  template <class T>
+  void ComputingUnitManager::load_result(TaskEntry const& task, T& ret) {
+    if (!task.load_inline(ret))
+      load_result(task.result_key, ret);
+  }
+
+  template <class T>
+  void ComputingUnitManager::load_result_view(Key const& result_key,
+      ArrayView<T>& view) {
+    typedef std::vector<T> vector_type;
+
+    std::lock_guard<std::recursive_mutex> lock(archive_mutex_);
+
+    std::shared_ptr<vector_type const> result =
+      result_cache_.get_shared<vector_type>(result_key);
+    if (!result)
+      result = writer_.get_shared<vector_type>(result_key);
+    if (result) {
+      view = ArrayView<T>(result, result->data(), result->size());
+      return;
+    }
+
+    std::shared_ptr<std::string> data_str(std::make_shared<std::string>());
+    archive_.load_raw(result_key, *data_str);
+    compressor_.decompress(*data_str);
+
+    // The values follow a header of 16 bytes, so they are usually aligned
+    char const* values;
+    size_t n_values;
+    if (fast_find_values<vector_type>(*data_str, values, n_values) &&
+        reinterpret_cast<uintptr_t>(values) % alignof(T) == 0) {
+      view = ArrayView<T>(data_str, reinterpret_cast<T const*>(values),
+          n_values);
+      return;
+    }
+
+    std::shared_ptr<vector_type> decoded(std::make_shared<vector_type>());
+    if (!fast_decode(*data_str, *decoded))
+      ObjectArchive<Key>::deserialize(*data_str, *decoded);
+    view = ArrayView<T>(decoded, decoded->data(), decoded->size());
+  }
+
+  template <class T>
+  void ComputingUnitManager::store_result(Key const& result_key,
+      std::shared_ptr<T const> const& result, std::string const& unit_id) {
+    if (asynchronous_writes_) {
+      // Results estimated by their serialization are counted without it
+      // until the writer serializes them
+      size_t size = object_size(*result, 0);
+      {
+        std::lock_guard<std::recursive_mutex> lock(archive_mutex_);
+        result_cache_.insert(result_key, result, size);
+      }
+
+      writer_.insert(result_key, result,
+          [this, result_key, result, unit_id]() {
+            size_t serialized_size;
+            std::string data_str = serialize_result(*result, unit_id,
+                serialized_size);
+            if (sized_by_serialization<T>::value) {
+              std::lock_guard<std::recursive_mutex> lock(archive_mutex_);
+              result_cache_.resize(result_key, result.get(),
+                  object_size(*result, serialized_size));
+            }
+            return data_str;
+          }, size);
+      return;
+    }
+
+    // Compression may take long, so it's done before locking
+    size_t serialized_size;
+    std::string data_str = serialize_result(*result, unit_id,
+        serialized_size);
+
+    std::lock_guard<std::recursive_mutex> lock(archive_mutex_);
+    archive_.insert_raw(result_key, std::move(data_str));
+    result_cache_.insert(result_key, result,
+        object_size(*result, serialized_size));
+  }
+
+  template <class T>
+  void ComputingUnitManager::store_result(TaskEntry& task,
+      std::shared_ptr<T const> const& result, std::string const& unit_id) {
+    if (task.store_inline(*result))
+      return;
+
+    {
+      std::lock_guard<std::recursive_mutex> lock(archive_mutex_);
+      task.result_key = new_key(Key::Result);
+    }
+
+    store_result(task.result_key, result, unit_id);
+  }
+
+  template <class T>
+  std::string ComputingUnitManager::serialize_result(T const& result,
+      std::string const& unit_id, size_t& serialized_size) {
+    std::string data_str = serialize_object(result);
+    serialized_size = data_str.size();
+    compressor_.compress(data_str, unit_id);
+    return data_str;
+  }
+
+  template <class T>
+  std::shared_ptr<T const> ComputingUnitManager::load_unit(
+      Key const& unit_key) {
+    if (!unit_key.is_valid())
+      return std::make_shared<T const>();
+
+    std::lock_guard<std::recursive_mutex> lock(archive_mutex_);
+
+    // Each key is used by a single kind of unit
+    auto it = units_.find(unit_key);
+    if (it != units_.end())
+      return std::static_pointer_cast<T const>(it->second);
+
+    std::shared_ptr<T> unit(std::make_shared<T>());
+    load_object(archive_, unit_key, *unit, compressor_);
+    units_.emplace(unit_key, unit);
+    return unit;
+  }
+};
+
+#endif
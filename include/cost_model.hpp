@@ -0,0 +1,109 @@
+// The time taken by each task is measured and aggregated by computing unit,
+// building a model of how expensive each unit is. This file describes the
+// model.
+//
+// For each unit, the model keeps the number of tasks measured, the mean and
+// variance of their wall time, the mean of their CPU time and a histogram of
+// the wall times, which gives approximate percentiles. The histogram has
+// logarithmic buckets, each 10^(1/8) times larger than the previous one, from
+// one microsecond up.
+//
+// Only the computation itself is measured, by a CostTimer around the call of
+// the unit, so that loading arguments and storing results aren't counted.
+//
+// The model is stored in the archive by the task manager, so that later runs
+// can use it to schedule tasks and estimate the remaining time.
+
+#ifndef __TASK_DISTRIBUTION__COST_MODEL_HPP__
+#define __TASK_DISTRIBUTION__COST_MODEL_HPP__
+
+#include <boost/serialization/map.hpp>
+#include <boost/serialization/string.hpp>
+#include <boost/serialization/vector.hpp>
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace TaskDistribution {
+  // Statistics of the tasks of one unit. Times are in seconds.
+  struct UnitCost {
+    size_t n_tasks;
+    double mean_wall_time;
+    double m2_wall_time;    // Sum of squared differences to the mean
+    size_t n_cpu_tasks;     // Tasks whose CPU time was measured
+    double mean_cpu_time;
+    std::vector<size_t> histogram;
+
+    UnitCost();
+
+    // Adds the measurement of one task. A negative CPU time means it wasn't
+    // measured.
+    void add(double wall_time, double cpu_time);
+
+    double variance_wall_time() const;
+
+    // Gets the approximate wall time below which the given fraction of tasks
+    // finished.
+    double percentile_wall_time(double fraction) const;
+
+    template<class Archive>
+    void serialize(Archive& ar, const unsigned int version) {
+      ar & n_tasks;
+      ar & mean_wall_time;
+      ar & m2_wall_time;
+      ar & n_cpu_tasks;
+      ar & mean_cpu_time;
+      ar & histogram;
+    }
+  };
+
+  // Times taken by the computation of one task, in seconds. A negative CPU
+  // time means it wasn't measured.
+  struct TaskCost {
+    double wall_time;
+    double cpu_time;
+  };
+
+  // Measures the times elapsed since its construction in the calling thread.
+  class CostTimer {
+    public:
+      CostTimer();
+
+      TaskCost elapsed() const;
+
+    private:
+      std::chrono::steady_clock::time_point wall_begin_;
+      double cpu_begin_;
+  };
+
+  class CostModel {
+    public:
+      // Adds the measurement of one task of the given unit.
+      void add(std::string const& unit_id, double wall_time,
+          double cpu_time = -1);
+
+      // Gets the statistics of the unit. Returns NULL if no task of the unit
+      // was measured.
+      UnitCost const* get(std::string const& unit_id) const;
+
+      // Gets the mean wall time of the unit's tasks, or the default value if
+      // no task of the unit was measured.
+      double get_mean_wall_time(std::string const& unit_id,
+          double default_value) const;
+
+      std::map<std::string, UnitCost> const& get_units() const;
+
+      void clear();
+
+      template<class Archive>
+      void serialize(Archive& ar, const unsigned int version) {
+        ar & units_;
+      }
+
+    private:
+      std::map<std::string, UnitCost> units_;
+  };
+};
+
+#endif
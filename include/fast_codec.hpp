@@ -0,0 +1,374 @@
+// Objects are serialized through boost when they are fingerprinted, stored and
+// loaded, which costs much more than copying their bytes for plain numbers and
+// vectors of them. This file defines a codec that stores such objects as their
+// raw bytes instead.
+//
+// The codec is selected at compile time by FastCodec<T>::enabled, which holds
+// for:
+// 1) types satisfying is_raw_copyable, whose bytes fully describe their values;
+// 2) std::vector and std::basic_string of these, stored as their sizes and
+//    bytes;
+// 3) std::tuple of types handled by the codec, element by element;
+// 4) PartialTuple of these tuples, storing only the positions not skipped, and
+//    StoredArguments with the same encoding.
+//
+// is_raw_copyable is defined in raw_copyable.hpp and may be specialized for the
+// user's types without padding.
+//
+// Objects are stored with a header, so that objects stored through boost, as
+// they were before the codec, can be told apart and loaded through boost. Like
+// boost's binary archives, the bytes depend on the machine's representation.
+// Stored objects may also be compressed, whichever way they are serialized, as
+// described in compression.hpp, and are decompressed when loaded.
+
+#ifndef __TASK_DISTRIBUTION__FAST_CODEC_HPP__
+#define __TASK_DISTRIBUTION__FAST_CODEC_HPP__
+
+#include "object_archive.hpp"
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include "compression.hpp"
+#include "key.hpp"
+#include "partial_tuple.hpp"
+#include "raw_copyable.hpp"
+
+namespace TaskDistribution {
+  // Types not handled by the codec, which are serialized through boost.
+  template <class T, class Enable = void>
+  struct FastCodec {
+    static bool const enabled = false;
+  };
+
+  template <class T>
+  struct FastCodec<T,
+    typename std::enable_if<is_raw_copyable<T>::value>::type> {
+    static bool const enabled = true;
+
+    static size_t size(T const& obj) { return sizeof(T); }
+
+    template <class Writer>
+    static void write(Writer& out, T const& obj) {
+      out.update(&obj, sizeof(T));
+    }
+
+    static bool read(char const*& in, char const* end, T& obj) {
+      if (size_t(end - in) < sizeof(T))
+        return false;
+      std::memcpy(&obj, in, sizeof(T));
+      in += sizeof(T);
+      return true;
+    }
+  };
+
+  // Contiguous sequences of raw values.
+  template <class Sequence>
+  struct FastSequenceCodec {
+    typedef typename Sequence::value_type value_type;
+
+    static bool const enabled = true;
+
+    static size_t size(Sequence const& obj) {
+      return sizeof(uint64_t) + obj.size() * sizeof(value_type);
+    }
+
+    template <class Writer>
+    static void write(Writer& out, Sequence const& obj) {
+      uint64_t n = obj.size();
+      out.update(&n, sizeof(n));
+      if (n != 0)
+        out.update(&obj[0], n * sizeof(value_type));
+    }
+
+    static bool read(char const*& in, char const* end, Sequence& obj) {
+      uint64_t n;
+      if (size_t(end - in) < sizeof(n))
+        return false;
+      std::memcpy(&n, in, sizeof(n));
+      in += sizeof(n);
+      if (n > size_t(end - in) / sizeof(value_type))
+        return false;
+
+      obj.resize(n);
+      if (n != 0)
+        std::memcpy(&obj[0], in, n * sizeof(value_type));
+      in += n * sizeof(value_type);
+      return true;
+    }
+  };
+
+  // std::vector<bool> doesn't store its values contiguously.
+  template <class T, class Allocator>
+  struct FastCodec<std::vector<T, Allocator>,
+    typename std::enable_if<is_raw_copyable<T>::value &&
+                            !std::is_same<T, bool>::value>::type>:
+    FastSequenceCodec<std::vector<T, Allocator>> { };
+
+  template <class CharT, class Traits, class Allocator>
+  struct FastCodec<std::basic_string<CharT, Traits, Allocator>,
+    typename std::enable_if<is_raw_copyable<CharT>::value>::type>:
+    FastSequenceCodec<std::basic_string<CharT, Traits, Allocator>> { };
+
+  // Whether every type is handled by the codec.
+  template <class... Types>
+  struct all_fast_codec: std::true_type { };
+
+  template <class T, class... Types>
+  struct all_fast_codec<T, Types...>:
+    std::integral_constant<bool, FastCodec<T>::enabled &&
+                                 all_fast_codec<Types...>::value> { };
+
+  // Elements of tuples, skipping the positions whose mask is true. A null mask
+  // skips nothing.
+  template <class Tuple, size_t I = 0, class Enable = void>
+  struct FastTupleCodec {
+    template <class Mask>
+    static size_t size(Tuple const& obj, Mask const* skip) { return 0; }
+
+    template <class Writer, class Mask>
+    static void write(Writer& out, Tuple const& obj, Mask const* skip) { }
+
+    template <class Mask>
+    static bool read(char const*& in, char const* end, Tuple& obj,
+        Mask const* skip) {
+      return true;
+    }
+  };
+
+  template <class Tuple, size_t I>
+  struct FastTupleCodec<Tuple, I,
+    typename std::enable_if<(I < std::tuple_size<Tuple>::value)>::type> {
+    typedef typename std::remove_const<typename std::remove_reference<
+      typename std::tuple_element<I, Tuple>::type>::type>::type element_type;
+    typedef FastCodec<element_type> codec;
+    typedef FastTupleCodec<Tuple, I + 1> next;
+
+    template <class Mask>
+    static size_t size(Tuple const& obj, Mask const* skip) {
+      size_t size = next::size(obj, skip);
+      if (skip == nullptr || !(*skip)[I])
+        size += codec::size(std::get<I>(obj));
+      return size;
+    }
+
+    template <class Writer, class Mask>
+    static void write(Writer& out, Tuple const& obj, Mask const* skip) {
+      if (skip == nullptr || !(*skip)[I])
+        codec::write(out, std::get<I>(obj));
+      next::write(out, obj, skip);
+    }
+
+    template <class Mask>
+    static bool read(char const*& in, char const* end, Tuple& obj,
+        Mask const* skip) {
+      if ((skip == nullptr || !(*skip)[I]) &&
+          !codec::read(in, end, std::get<I>(obj)))
+        return false;
+      return next::read(in, end, obj, skip);
+    }
+  };
+
+  template <class... Types>
+  struct FastCodec<std::tuple<Types...>,
+    typename std::enable_if<all_fast_codec<Types...>::value>::type> {
+    typedef std::tuple<Types...> tuple_type;
+    typedef FastTupleCodec<tuple_type> elements;
+    typedef std::array<bool, sizeof...(Types)> Mask;
+
+    static bool const enabled = true;
+
+    static size_t size(tuple_type const& obj) {
+      return elements::size(obj, (Mask const*)nullptr);
+    }
+
+    template <class Writer>
+    static void write(Writer& out, tuple_type const& obj) {
+      elements::write(out, obj, (Mask const*)nullptr);
+    }
+
+    static bool read(char const*& in, char const* end, tuple_type& obj) {
+      return elements::read(in, end, obj, (Mask const*)nullptr);
+    }
+  };
+
+  template <class Tuple>
+  struct FastCodec<PartialTuple<Tuple>,
+    typename std::enable_if<
+      FastCodec<typename std::remove_const<Tuple>::type>::enabled>::type> {
+    typedef typename std::remove_const<Tuple>::type tuple_type;
+    typedef FastTupleCodec<tuple_type> elements;
+
+    static bool const enabled = true;
+
+    static size_t size(PartialTuple<Tuple> const& obj) {
+      return elements::size(obj.get_tuple(), &obj.get_mask());
+    }
+
+    template <class Writer>
+    static void write(Writer& out, PartialTuple<Tuple> const& obj) {
+      elements::write(out, obj.get_tuple(), &obj.get_mask());
+    }
+
+    static bool read(char const*& in, char const* end,
+        PartialTuple<Tuple>& obj) {
+      return elements::read(in, end, obj.get_tuple(), &obj.get_mask());
+    }
+  };
+
+  // Encoded as the PartialTuple it's loaded through, so it's enabled if the
+  // full tuple is handled by the codec. It's never decoded.
+  template <class Tuple, class StoredTuple>
+  struct FastCodec<StoredArguments<Tuple, StoredTuple>,
+    typename std::enable_if<FastCodec<Tuple>::enabled>::type> {
+    typedef FastTupleCodec<StoredTuple> elements;
+    typedef std::array<bool, std::tuple_size<StoredTuple>::value> Mask;
+
+    static bool const enabled = true;
+
+    static size_t size(StoredArguments<Tuple, StoredTuple> const& obj) {
+      return elements::size(obj.get_tuple(), (Mask const*)nullptr);
+    }
+
+    template <class Writer>
+    static void write(Writer& out,
+        StoredArguments<Tuple, StoredTuple> const& obj) {
+      elements::write(out, obj.get_tuple(), (Mask const*)nullptr);
+    }
+  };
+
+  // Header of the objects stored by the codec. Boost's binary archives start
+  // with a size or the object's own bytes, which are checked to fill the
+  // object exactly, so they aren't confused with it.
+  static char const fast_codec_header[8] =
+    {'T', 'D', 'F', 'C', '\x01', '\0', '\0', '\0'};
+
+  // Writer that copies the bytes to a buffer large enough for them.
+  struct FastCodecBuffer {
+    char* position;
+
+    void update(void const* data, size_t size) {
+      std::memcpy(position, data, size);
+      position += size;
+    }
+  };
+
+  // Gives the object's encoding to the writer, which may be a buffer or any
+  // class with the same update() method, like FingerprintHasher.
+  template <class T, class Writer>
+  void fast_write(Writer& out, T const& obj) {
+    out.update(fast_codec_header, sizeof(fast_codec_header));
+    FastCodec<T>::write(out, obj);
+  }
+
+  // Encodes the object with the codec.
+  template <class T>
+  std::string fast_encode(T const& obj) {
+    std::string data_str(sizeof(fast_codec_header) +
+        FastCodec<T>::size(obj), '\0');
+    FastCodecBuffer buffer = {&data_str[0]};
+    fast_write(buffer, obj);
+    return data_str;
+  }
+
+  // Decodes the object encoded by fast_encode(). Returns false if data_str
+  // wasn't encoded by the codec for T, in which case obj may be changed.
+  template <class T>
+  bool fast_decode(std::string const& data_str, T& obj) {
+    if (data_str.size() < sizeof(fast_codec_header) ||
+        std::memcmp(data_str.data(), fast_codec_header,
+          sizeof(fast_codec_header)) != 0)
+      return false;
+
+    char const* in = data_str.data() + sizeof(fast_codec_header);
+    char const* end = data_str.data() + data_str.size();
+    return FastCodec<T>::read(in, end, obj) && in == end;
+  }
+
+  // Finds the values of a vector or string encoded by fast_encode() without
+  // copying them. Returns false if data_str wasn't encoded by the codec for
+  // Sequence. The values may not be aligned for their type.
+  template <class Sequence>
+  bool fast_find_values(std::string const& data_str, char const*& values,
+      size_t& n_values) {
+    typedef typename Sequence::value_type value_type;
+    static_assert(std::is_base_of<FastSequenceCodec<Sequence>,
+        FastCodec<Sequence>>::value,
+        "only contiguous sequences of raw values can be found");
+
+    uint64_t n;
+    size_t prefix_size = sizeof(fast_codec_header) + sizeof(n);
+    if (data_str.size() < prefix_size ||
+        std::memcmp(data_str.data(), fast_codec_header,
+          sizeof(fast_codec_header)) != 0)
+      return false;
+
+    std::memcpy(&n, data_str.data() + sizeof(fast_codec_header), sizeof(n));
+    if (n != (data_str.size() - prefix_size) / sizeof(value_type) ||
+        (data_str.size() - prefix_size) % sizeof(value_type) != 0)
+      return false;
+
+    values = data_str.data() + prefix_size;
+    n_values = n;
+    return true;
+  }
+
+  // Serializes the object with the codec, if it handles T, or through boost.
+  template <class T>
+  std::string serialize_object(T const& obj);
+
+  // Loads the object stored with the key, whatever way it was serialized,
+  // decompressing it with the compressor if needed. The archive's mutex must be
+  // held. Returns the size of the object's serialization.
+  template <class T>
+  size_t load_object(ObjectArchive<Key>& archive, Key const& key, T& obj,
+      ObjectCompressor& compressor);
+
+  namespace detail {
+    template <class T>
+    std::string serialize_object(T const& obj, std::true_type) {
+      return fast_encode(obj);
+    }
+
+    template <class T>
+    std::string serialize_object(T const& obj, std::false_type) {
+      return ObjectArchive<Key>::serialize(obj);
+    }
+
+    template <class T>
+    bool decode_object(std::string const& data_str, T& obj, std::true_type) {
+      return fast_decode(data_str, obj);
+    }
+
+    template <class T>
+    bool decode_object(std::string const& data_str, T& obj,
+        std::false_type) {
+      return false;
+    }
+  };
+
+  template <class T>
+  std::string serialize_object(T const& obj) {
+    return detail::serialize_object(obj,
+        std::integral_constant<bool, FastCodec<T>::enabled>());
+  }
+
+  template <class T>
+  size_t load_object(ObjectArchive<Key>& archive, Key const& key, T& obj,
+      ObjectCompressor& compressor) {
+    std::string data_str;
+    archive.load_raw(key, data_str);
+    compressor.decompress(data_str);
+    if (!detail::decode_object(data_str, obj,
+          std::integral_constant<bool, FastCodec<T>::enabled>()))
+      ObjectArchive<Key>::deserialize(data_str, obj);
+    return data_str.size();
+  }
+};
+
+#endif
@@ -0,0 +1,174 @@
+// Objects stored by the task manager are identified by their contents, so that
+// the same data isn't stored twice. This file defines the fingerprint used to
+// identify the contents.
+//
+// The fingerprint has 128 bits and is computed with MurmurHash3 (x64, 128-bit
+// variant), which processes the data in blocks of 16 bytes using two
+// independent 64-bit lanes. With this size, collisions are unlikely enough that
+// two objects with the same fingerprint may be considered equal without
+// comparing their bytes.
+//
+// The data can be provided in many pieces through FingerprintHasher, which
+// gives the same fingerprint as if all pieces were provided at once. This
+// allows objects to be fingerprinted as they are serialized through boost,
+// without building the serialized string. Small serializations may still be
+// kept, so that they can be stored without serializing the object again.
+
+#ifndef __TASK_DISTRIBUTION__FINGERPRINT_HPP__
+#define __TASK_DISTRIBUTION__FINGERPRINT_HPP__
+
+#include <boost/archive/binary_oarchive.hpp>
+#include <cstdint>
+#include <functional>
+#include <streambuf>
+#include <string>
+
+namespace TaskDistribution {
+  struct Fingerprint {
+    uint64_t low;
+    uint64_t high;
+
+    Fingerprint(): low(0), high(0) { }
+
+    Fingerprint(uint64_t _low, uint64_t _high):
+      low(_low),
+      high(_high) { }
+
+    bool operator==(Fingerprint const& other) const {
+      return low == other.low && high == other.high;
+    }
+
+    bool operator!=(Fingerprint const& other) const {
+      return !(*this == other);
+    }
+
+    template<class Archive>
+    void serialize(Archive& ar, const unsigned int version) {
+      ar & low;
+      ar & high;
+    }
+
+    // Computes the fingerprint of the given data.
+    static Fingerprint of(void const* data, size_t size);
+    static Fingerprint of(std::string const& data);
+
+    // Computes the fingerprint of the object's serialization, which is
+    // streamed directly into the hasher.
+    template <class T>
+    static Fingerprint of_object(T const& obj);
+
+    // As above, also giving the serialization in data_str if it has at most
+    // max_size bytes. Otherwise, data_str is left empty.
+    template <class T>
+    static Fingerprint of_object(T const& obj, std::string& data_str,
+        size_t max_size);
+  };
+
+  // Computes the fingerprint of data provided in pieces.
+  class FingerprintHasher {
+    public:
+      FingerprintHasher();
+
+      // Adds more data to the end of the current one.
+      void update(void const* data, size_t size);
+
+      // Gets the fingerprint of all data provided.
+      Fingerprint finish() const;
+
+      // Total size of the data provided.
+      size_t size() const { return length_; }
+
+    private:
+      // Mixes a full block of 16 bytes into the state.
+      void process_block(unsigned char const* block);
+
+      uint64_t h1_, h2_;
+      size_t length_;
+
+      // Bytes that don't fill a block yet.
+      unsigned char buffer_[16];
+      size_t buffer_size_;
+  };
+
+  // Output buffer that gives everything written to a hasher. The data may
+  // also be kept in a string until it exceeds the given size, after which the
+  // string is emptied and nothing else is kept.
+  class FingerprintStreamBuf: public std::streambuf {
+    public:
+      explicit FingerprintStreamBuf(FingerprintHasher& hasher,
+          std::string* kept = nullptr, size_t max_kept = 0):
+        hasher_(hasher),
+        kept_(kept),
+        max_kept_(max_kept) { }
+
+    protected:
+      virtual std::streamsize xsputn(char const* s, std::streamsize n) {
+        hasher_.update(s, n);
+        keep(s, n);
+        return n;
+      }
+
+      virtual int_type overflow(int_type c) {
+        if (!traits_type::eq_int_type(c, traits_type::eof())) {
+          char ch = traits_type::to_char_type(c);
+          hasher_.update(&ch, 1);
+          keep(&ch, 1);
+        }
+        return traits_type::not_eof(c);
+      }
+
+    private:
+      void keep(char const* s, size_t n) {
+        if (kept_ == nullptr)
+          return;
+
+        if (kept_->size() + n > max_kept_) {
+          kept_->clear();
+          kept_ = nullptr;
+        }
+        else
+          kept_->append(s, n);
+      }
+
+      FingerprintHasher& hasher_;
+      std::string* kept_;
+      size_t max_kept_;
+  };
+
+  template <class T>
+  Fingerprint Fingerprint::of_object(T const& obj) {
+    std::string data_str;
+    return of_object(obj, data_str, 0);
+  }
+
+  template <class T>
+  Fingerprint Fingerprint::of_object(T const& obj, std::string& data_str,
+      size_t max_size) {
+    data_str.clear();
+
+    FingerprintHasher hasher;
+    FingerprintStreamBuf buffer(hasher, &data_str, max_size);
+    {
+      boost::archive::binary_oarchive ar(buffer,
+          boost::archive::no_header | boost::archive::no_codecvt);
+      ar << obj;
+    }
+    return hasher.finish();
+  }
+};
+
+// Allows Fingerprint to be used as key in std::unordered_*.
+namespace std {
+  template<>
+  struct hash<TaskDistribution::Fingerprint> {
+    typedef TaskDistribution::Fingerprint argument_type;
+    typedef size_t value_type;
+
+    // The fingerprint is already well mixed, so any part of it is enough.
+    value_type operator()(TaskDistribution::Fingerprint const& f) const {
+      return f.low;
+    }
+  };
+};
+
+#endif
@@ -0,0 +1,136 @@
+// Parents and children of each task are stored as sets of keys, which are
+// loaded, changed and stored again while tasks are created. This file defines a
+// set of keys kept as a sorted vector, which is smaller and faster to iterate
+// and serialize than a tree.
+//
+// Inserting keys larger than every other, as new tasks usually are, just
+// appends them. Inserting in the middle moves the keys after it, so many keys
+// in random order should be inserted at once with the range insert.
+//
+// The set is serialized just like a std::set<Key>, so that archives with
+// family lists stored before can still be read.
+
+#ifndef __TASK_DISTRIBUTION__FLAT_KEY_SET_HPP__
+#define __TASK_DISTRIBUTION__FLAT_KEY_SET_HPP__
+
+#include <boost/archive/basic_archive.hpp>
+#include <boost/serialization/collection_size_type.hpp>
+#include <boost/serialization/item_version_type.hpp>
+#include <boost/serialization/nvp.hpp>
+#include <boost/serialization/split_member.hpp>
+#include <boost/serialization/version.hpp>
+#include <initializer_list>
+#include <utility>
+#include <vector>
+
+#include "key.hpp"
+
+namespace TaskDistribution {
+  class FlatKeySet {
+    public:
+      typedef Key value_type;
+      typedef std::vector<Key>::size_type size_type;
+      typedef std::vector<Key>::const_iterator iterator;
+      typedef std::vector<Key>::const_iterator const_iterator;
+
+      FlatKeySet() { }
+
+      FlatKeySet(std::initializer_list<Key> keys);
+
+      template <class InputIterator>
+      FlatKeySet(InputIterator first, InputIterator last);
+
+      // Inserts the key if it isn't in the set yet. Returns its position and
+      // whether it was inserted.
+      std::pair<iterator, bool> insert(Key const& key);
+
+      // Inserts every key in the range, sorting them only once.
+      template <class InputIterator>
+      void insert(InputIterator first, InputIterator last);
+
+      // Removes the key, returning the number of keys removed.
+      size_type erase(Key const& key);
+
+      iterator find(Key const& key) const;
+      size_type count(Key const& key) const;
+
+      iterator begin() const { return keys_.begin(); }
+      iterator end() const { return keys_.end(); }
+
+      size_type size() const { return keys_.size(); }
+      bool empty() const { return keys_.empty(); }
+
+      void clear() { keys_.clear(); }
+      void reserve(size_type size) { keys_.reserve(size); }
+
+      bool operator==(FlatKeySet const& other) const {
+        return keys_ == other.keys_;
+      }
+
+      bool operator!=(FlatKeySet const& other) const {
+        return keys_ != other.keys_;
+      }
+
+      template <class Archive>
+      void save(Archive& ar, const unsigned int version) const;
+
+      template <class Archive>
+      void load(Archive& ar, const unsigned int version);
+
+      BOOST_SERIALIZATION_SPLIT_MEMBER()
+
+    private:
+      // Sorts the keys from position first onwards, merges them with the keys
+      // before it, which must be sorted, and removes duplicates.
+      void merge_from(size_type first);
+
+      std::vector<Key> keys_;
+  };
+
+  template <class InputIterator>
+  FlatKeySet::FlatKeySet(InputIterator first, InputIterator last) {
+    insert(first, last);
+  }
+
+  template <class InputIterator>
+  void FlatKeySet::insert(InputIterator first, InputIterator last) {
+    size_type old_size = keys_.size();
+    keys_.insert(keys_.end(), first, last);
+    merge_from(old_size);
+  }
+
+  // Same layout used by boost for std::set.
+  template <class Archive>
+  void FlatKeySet::save(Archive& ar, const unsigned int version) const {
+    boost::serialization::collection_size_type count(keys_.size());
+    boost::serialization::item_version_type item_version(
+        boost::serialization::version<Key>::value);
+    ar << BOOST_SERIALIZATION_NVP(count);
+    ar << BOOST_SERIALIZATION_NVP(item_version);
+
+    for (auto const& key : keys_)
+      ar << boost::serialization::make_nvp("item", key);
+  }
+
+  template <class Archive>
+  void FlatKeySet::load(Archive& ar, const unsigned int version) {
+    boost::serialization::collection_size_type count;
+    boost::serialization::item_version_type item_version(0);
+    ar >> BOOST_SERIALIZATION_NVP(count);
+    if (boost::archive::library_version_type(3) < ar.get_library_version())
+      ar >> BOOST_SERIALIZATION_NVP(item_version);
+
+    keys_.clear();
+    keys_.reserve(count);
+    for (size_type i = 0; i < count; i++) {
+      Key key;
+      ar >> boost::serialization::make_nvp("item", key);
+      keys_.push_back(key);
+    }
+
+    // Stored sets are sorted already, so this just checks them
+    merge_from(0);
+  }
+};
+
+#endif
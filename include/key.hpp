@@ -9,6 +9,24 @@
 //
 // By default, a key is considered invalid if the object associated with it has
 // id == 0 or its type is unknown.
+//
+// Object ids are taken by each thread from its own range of ids, leased from a
+// shared counter, so that keys may be created by many threads without
+// contention. Thus ids don't follow the creation order and some ids are never
+// used. Each node has its own counter, as its keys have its id.
+//
+// The library may also store its own data in the archive, like indexes that
+// speed up start-up. These objects use metadata keys, whose node can't be used
+// by any process, so they never conflict with keys created with "new_key".
+//
+// If PACKED_KEY is defined, the key is packed in 64 bits, with the node in the
+// highest 16 bits, then the type in 4 bits and the object id in the lowest 44
+// bits. This reduces the memory used by task entries and key sets and the size
+// of MPI messages, but limits the number of nodes and objects, and keys beyond
+// these limits throw std::overflow_error, even without asserts. The fields must
+// be accessed with the getters, which are available in both layouts. Keys are
+// stored in the archive with the same format in both layouts, so archives can
+// be shared between them.
 
 #ifndef __TASK_DISTRIBUTION__KEY_HPP__
 #define __TASK_DISTRIBUTION__KEY_HPP__
@@ -16,10 +34,23 @@
 #if ENABLE_MPI
 #include <boost/mpi/communicator.hpp>
 #endif
+#if ENABLE_MPI && PACKED_KEY
+#include <boost/mpi/detail/mpi_datatype_oarchive.hpp>
+#include <boost/mpi/packed_iarchive.hpp>
+#include <boost/mpi/packed_oarchive.hpp>
+#endif
+#include <atomic>
+#include <boost/assert.hpp>
 #include <boost/functional/hash.hpp>
+#include <boost/serialization/split_member.hpp>
+#include <cstdint>
+#include <type_traits>
 #include <functional>
+#include <limits>
 #include <list>
 #include <set>
+#include <stdexcept>
+#include <vector>
 
 namespace TaskDistribution {
   // General key for the archive used.
@@ -33,9 +64,49 @@ namespace TaskDistribution {
       ComputingUnitId,
       Parents,
       Children,
-      Unknown
+      Unknown,
+      // New types are placed after Unknown to keep archived values
+      Metadata
     };
 
+#if PACKED_KEY
+    static unsigned const type_bits = 4;
+    static unsigned const obj_bits = 44;
+
+    // Node whose bits are all set. It's reserved for metadata keys.
+    static size_t const packed_max_node =
+      ~uint64_t(0) >> (type_bits + obj_bits);
+
+    // Constructs invalid keys as default.
+    Key(): bits_(pack(0, 0, Unknown)) { }
+
+    Key(size_t node, size_t obj, Type _type):
+      bits_(pack(node, obj, _type)) { }
+
+    size_t get_node_id() const {
+      size_t node = bits_ >> (type_bits + obj_bits);
+      return node == packed_max_node ? std::numeric_limits<size_t>::max() :
+                                       node;
+    }
+
+    size_t get_obj_id() const { return bits_ & obj_mask(); }
+
+    Type get_type() const {
+      return Type((bits_ & type_mask()) >> obj_bits);
+    }
+
+    // Bits that identify the key, without its type.
+    uint64_t get_id_bits() const { return bits_ & ~type_mask(); }
+
+    bool operator==(Key const& other) const {
+      return get_id_bits() == other.get_id_bits();
+    }
+
+    // The node is in the highest bits, so this orders by node and object id.
+    bool operator<(Key const& other) const {
+      return get_id_bits() < other.get_id_bits();
+    }
+#else
     size_t node_id;
     size_t obj_id;
     Type type;
@@ -48,7 +119,9 @@ namespace TaskDistribution {
       obj_id(obj),
       type(_type){ }
 
-    bool is_valid() const { return obj_id != 0 && type != Unknown; }
+    size_t get_node_id() const { return node_id; }
+    size_t get_obj_id() const { return obj_id; }
+    Type get_type() const { return type; }
 
     bool operator==(Key const& other) const {
       return node_id == other.node_id &&
@@ -62,26 +135,81 @@ namespace TaskDistribution {
         return false;
       return obj_id < other.obj_id;
     }
+#endif
+
+    bool is_valid() const {
+      return get_obj_id() != 0 && get_type() != Unknown;
+    }
+
+    bool is_metadata() const { return get_type() == Metadata; }
+
+    // Creates the key for the metadata object with the given id.
+    static Key metadata_key(size_t obj) {
+      return Key(std::numeric_limits<size_t>::max(), obj, Metadata);
+    }
 
     bool operator>(Key const& other) const {
       return other < *this;
     }
 
+#if PACKED_KEY
+    // The archive keeps the unpacked format, while MPI messages use the bits.
+    template<class Archive>
+    void save(Archive& ar, const unsigned int version) const {
+      if (is_message_archive<Archive>::value) {
+        ar & bits_;
+        return;
+      }
+
+      size_t node_id = get_node_id(), obj_id = get_obj_id();
+      Type type = get_type();
+      ar & node_id;
+      ar & obj_id;
+      ar & type;
+    }
+
+    template<class Archive>
+    void load(Archive& ar, const unsigned int version) {
+      if (is_message_archive<Archive>::value) {
+        ar & bits_;
+        return;
+      }
+
+      size_t node_id, obj_id;
+      Type type;
+      ar & node_id;
+      ar & obj_id;
+      ar & type;
+      bits_ = pack(node_id, obj_id, type);
+    }
+
+    BOOST_SERIALIZATION_SPLIT_MEMBER()
+#else
     template<class Archive>
     void serialize(Archive& ar, const unsigned int version) {
       ar & node_id;
       ar & obj_id;
       ar & type;
     }
+#endif
+
+    // Creates a new unique key. Object ids are leased to each thread in
+    // contiguous ranges, so that threads don't share a counter for each key.
+    // next_obj is the first id not leased yet.
+    static std::atomic<size_t> next_obj;
+    static size_t const obj_lease_size = 1024;
+
+    // Ensures that new keys have object ids of at least obj. Ranges already
+    // leased are dropped if they have smaller ids. Must not be called while
+    // other threads create keys.
+    static void update_next_obj(size_t obj);
+
+    // Gets a new object id from the thread's range.
+    static size_t new_obj();
 
-    // Creates a new unique key. The method has an internal counter to guarantee
-    // that each key created is unique.
-    static size_t next_obj;
 #if ENABLE_MPI
     static Key new_key(boost::mpi::communicator& world, Type type) {
-      Key ret({0, next_obj++, type});
-      ret.node_id = world.rank();
-      return ret;
+      return Key(world.rank(), new_obj(), type);
     }
 
     static Key new_key(Type type) {
@@ -91,13 +219,58 @@ namespace TaskDistribution {
     }
 #else
     static Key new_key(Type type) {
-      Key ret({0, next_obj++, type});
+      Key ret({0, new_obj(), type});
       return ret;
     }
 #endif
+
+#if PACKED_KEY
+    private:
+      static uint64_t obj_mask() {
+        return (uint64_t(1) << obj_bits) - 1;
+      }
+
+      static uint64_t type_mask() {
+        return ((uint64_t(1) << type_bits) - 1) << obj_bits;
+      }
+
+      // Fields that don't fit would give the key of another object, so they
+      // are always checked.
+      static uint64_t pack(size_t node, size_t obj, Type type) {
+        if (node == std::numeric_limits<size_t>::max())
+          node = packed_max_node;
+        if (node > packed_max_node)
+          throw std::overflow_error("node doesn't fit the key");
+        if (obj > obj_mask())
+          throw std::overflow_error("object id doesn't fit the key");
+        return (uint64_t(node) << (type_bits + obj_bits)) |
+               (uint64_t(type) << obj_bits) | obj;
+      }
+
+      // MPI archives are only used for messages, which may use the packed
+      // format.
+      template <class Archive>
+      struct is_message_archive: std::false_type { };
+
+      uint64_t bits_;
+#endif
   };
 
-  typedef std::list<Key> KeyList;
+#if PACKED_KEY && ENABLE_MPI
+  template <>
+  struct Key::is_message_archive<boost::mpi::packed_oarchive>:
+    std::true_type { };
+
+  template <>
+  struct Key::is_message_archive<boost::mpi::packed_iarchive>:
+    std::true_type { };
+
+  template <>
+  struct Key::is_message_archive<boost::mpi::detail::mpi_datatype_oarchive>:
+    std::true_type { };
+#endif
+
+  typedef std::vector<Key> KeyList;
   typedef std::set<Key> KeySet;
 };
 
@@ -113,6 +286,15 @@ namespace std {
     typedef TaskDistribution::Key argument_type;
     typedef size_t value_type;
 
+#if PACKED_KEY
+    // Mixes the bits with the splitmix64 finalizer.
+    value_type operator()(TaskDistribution::Key const& key) const {
+      uint64_t z = key.get_id_bits();
+      z = (z ^ (z >> 30)) * UINT64_C(0xbf58476d1ce4e5b9);
+      z = (z ^ (z >> 27)) * UINT64_C(0x94d049bb133111eb);
+      return z ^ (z >> 31);
+    }
+#else
     value_type operator()(TaskDistribution::Key const& key) const {
       size_t seed = 0;
       std::hash<size_t> hasher;
@@ -121,6 +303,7 @@ namespace std {
 
       return seed;
     }
+#endif
   };
 };
 
@@ -0,0 +1,157 @@
+// Provides the mechanism to serialize only some elements of a tuple.
+//
+// The arguments of a task are stored as a tuple, but the arguments given as
+// tasks are only known when the parents finish. Wrapping the tuple with a mask
+// that marks the positions filled by tasks allows only the other positions to
+// be serialized. The mask must be the same when saving and loading, which is
+// guaranteed as it's built from the tuple of tasks arguments.
+//
+// The wrapper has class version 1. Version 0 is used by plain tuples stored by
+// older versions, so that they can still be loaded through the wrapper.
+//
+// When a task is created, which arguments are tasks is known at compile time,
+// so only the other arguments are gathered in a StoredArguments, without a
+// value for the tasks' positions. It's serialized exactly as the PartialTuple
+// of the full tuple, so that it's loaded through the PartialTuple.
+
+#ifndef __TASK_DISTRIBUTION__PARTIAL_TUPLE_HPP__
+#define __TASK_DISTRIBUTION__PARTIAL_TUPLE_HPP__
+
+#include "sequence.hpp"
+
+#include <array>
+#include <boost/serialization/split_member.hpp>
+#include <boost/serialization/version.hpp>
+#include <tuple>
+#include <type_traits>
+
+#include "tuple_serialize.hpp"
+
+namespace TaskDistribution {
+  template <class Tuple>
+  class PartialTuple {
+    public:
+      typedef std::array<bool,
+              std::tuple_size<typename std::remove_const<Tuple>::type>::value>
+        Mask;
+
+      // Positions whose mask is true are skipped.
+      PartialTuple(Tuple& tuple, Mask const& skip):
+        tuple_(tuple),
+        skip_(skip) { }
+
+      template<class Archive>
+      void save(Archive& ar, const unsigned int version) const {
+        save_detail<0>(ar);
+      }
+
+      template<class Archive>
+      void load(Archive& ar, const unsigned int version) {
+        if (version == 0)
+          serialize_tuple<0>(ar, tuple_, version);
+        else
+          load_detail<0>(ar);
+      }
+
+      BOOST_SERIALIZATION_SPLIT_MEMBER()
+
+      // Used by encoders other than boost's archives.
+      Tuple& get_tuple() const { return tuple_; }
+      Mask const& get_mask() const { return skip_; }
+
+      // Builds the mask that skips the valid keys.
+      template <class KeysTuple>
+      static Mask make_mask(KeysTuple const& keys) {
+        return make_mask_detail(keys,
+            typename CompileUtils::tuple_sequence_generator<KeysTuple>::type());
+      }
+
+    private:
+      template <class KeysTuple, size_t... S>
+      static Mask make_mask_detail(KeysTuple const& keys,
+          CompileUtils::sequence<S...>) {
+        return Mask({{std::get<S>(keys).is_valid()...}});
+      }
+
+      template <size_t I, class Archive>
+      typename std::enable_if<(I == std::tuple_size<Mask>::value), void>::type
+      save_detail(Archive& ar) const { }
+
+      template <size_t I, class Archive>
+      typename std::enable_if<(I < std::tuple_size<Mask>::value), void>::type
+      save_detail(Archive& ar) const {
+        if (!skip_[I])
+          ar << std::get<I>(tuple_);
+        save_detail<I + 1>(ar);
+      }
+
+      template <size_t I, class Archive>
+      typename std::enable_if<(I == std::tuple_size<Mask>::value), void>::type
+      load_detail(Archive& ar) { }
+
+      template <size_t I, class Archive>
+      typename std::enable_if<(I < std::tuple_size<Mask>::value), void>::type
+      load_detail(Archive& ar) {
+        if (!skip_[I])
+          ar >> std::get<I>(tuple_);
+        load_detail<I + 1>(ar);
+      }
+
+      Tuple& tuple_;
+      Mask skip_;
+  };
+
+  // Arguments of a task given as values, in the order of Tuple, the unit's
+  // arguments. StoredTuple holds them by reference when possible. It's only
+  // saved, as it's loaded through PartialTuple<Tuple>.
+  template <class Tuple, class StoredTuple>
+  class StoredArguments {
+    public:
+      explicit StoredArguments(StoredTuple const& stored):
+        stored_(stored) { }
+
+      template<class Archive>
+      void save(Archive& ar, const unsigned int version) const {
+        save_detail<0>(ar);
+      }
+
+      BOOST_SERIALIZATION_SPLIT_MEMBER()
+
+      // Used by encoders other than boost's archives.
+      StoredTuple const& get_tuple() const { return stored_; }
+
+    private:
+      template <size_t I, class Archive>
+      typename std::enable_if<(I == std::tuple_size<StoredTuple>::value),
+               void>::type
+      save_detail(Archive& ar) const { }
+
+      template <size_t I, class Archive>
+      typename std::enable_if<(I < std::tuple_size<StoredTuple>::value),
+               void>::type
+      save_detail(Archive& ar) const {
+        ar << std::get<I>(stored_);
+        save_detail<I + 1>(ar);
+      }
+
+      StoredTuple stored_;
+  };
+};
+
+namespace boost { namespace serialization {
+  template <class Tuple>
+  struct version<TaskDistribution::PartialTuple<Tuple>> {
+    typedef mpl::int_<1> type;
+    typedef mpl::integral_c_tag tag;
+    BOOST_STATIC_CONSTANT(int, value = 1);
+  };
+
+  template <class Tuple, class StoredTuple>
+  struct version<TaskDistribution::StoredArguments<Tuple, StoredTuple>> {
+    typedef mpl::int_<1> type;
+    typedef mpl::integral_c_tag tag;
+    BOOST_STATIC_CONSTANT(int, value = 1);
+  };
+}; };
+
+#endif
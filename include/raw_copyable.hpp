@@ -0,0 +1,25 @@
+// Some objects are stored as their raw bytes, which is much faster than
+// serializing them. This file defines which types may be stored this way.
+//
+// is_raw_copyable holds for arithmetic and enum types. Trivially copyable types
+// in general may have padding, whose bytes are indeterminate and would give the
+// same value different fingerprints, so the trait must be specialized as true
+// for the user's types known to have no padding. long double is excluded as it
+// has padding on most machines.
+
+#ifndef __TASK_DISTRIBUTION__RAW_COPYABLE_HPP__
+#define __TASK_DISTRIBUTION__RAW_COPYABLE_HPP__
+
+#include <type_traits>
+
+namespace TaskDistribution {
+  // Whether the bytes of T fully describe its value.
+  template <class T>
+  struct is_raw_copyable:
+    std::integral_constant<bool,
+      (std::is_arithmetic<T>::value &&
+       !std::is_same<T, long double>::value) ||
+      std::is_enum<T>::value> { };
+};
+
+#endif
@@ -0,0 +1,85 @@
+// Tasks that are ready to run are kept by the task manager in a queue, which is
+// described in this file.
+//
+// By default, tasks are given back in the order they were added. The queue may
+// also be prioritized, in which case tasks with larger priority are given back
+// first and ties are broken by the order they were added. As the same task may
+// be found ready more than once while the tasks are created, the queue also
+// keeps the set of tasks in it, so that duplicates are ignored in constant
+// time.
+//
+// Each task may be added with an index, such as its node in the task graph,
+// which is given back with it.
+
+#ifndef __TASK_DISTRIBUTION__READY_QUEUE_HPP__
+#define __TASK_DISTRIBUTION__READY_QUEUE_HPP__
+
+#include <deque>
+#include <functional>
+#include <unordered_set>
+#include <vector>
+
+#include "key.hpp"
+
+namespace TaskDistribution {
+  class ReadyQueue {
+    public:
+      typedef std::function<double (Key const&)> priority_function_type;
+
+      // Index of tasks added without one.
+      static size_t const no_index = size_t(-1);
+
+      ReadyQueue();
+
+      // Adds the task to the end of the queue. Returns false if the task is
+      // already in the queue.
+      bool push(Key const& task_key, double priority = 0,
+          size_t index = no_index);
+
+      // Removes the first task of the queue and returns it. The queue must not
+      // be empty.
+      Key pop();
+
+      // Same as above, also giving the index the task was added with.
+      Key pop(size_t& index);
+
+      // Checks if the task is in the queue.
+      bool contains(Key const& task_key) const;
+
+      bool empty() const;
+      size_t size() const;
+
+      // Chooses whether priorities are used, keeping the tasks in the queue.
+      void set_prioritized(bool prioritized);
+      bool is_prioritized() const;
+
+      // Computes again the priority of every task in the queue.
+      void update_priorities(priority_function_type const& priority);
+
+    private:
+      struct Item {
+        Key task_key;
+        double priority;
+        size_t order;
+        size_t index;
+
+        // Heap order, so that the "largest" item is the one given first.
+        bool operator<(Item const& other) const {
+          if (priority != other.priority)
+            return priority < other.priority;
+          return order > other.order;
+        }
+      };
+
+      bool prioritized_;
+      size_t next_order_;
+
+      // Only one of them is used, depending on prioritized_.
+      std::deque<Item> queue_;
+      std::vector<Item> heap_;
+
+      std::unordered_set<Key> keys_;
+  };
+};
+
+#endif
@@ -0,0 +1,342 @@
+// The result of a task is loaded from the archive by each of its children and
+// by the user, so a result used many times is deserialized many times. This
+// file defines a cache of deserialized results kept in front of the archive.
+//
+// Each entry holds a typed copy of a result, identified by the result's key.
+// The type is checked when the result is requested, so that a result requested
+// with another type is just loaded again from the archive. The memory used by
+// each entry is estimated by object_size(), and the least recently used entries
+// are removed when the total estimated memory passes the capacity.
+//
+// object_size() knows the trivially copyable types, strings and the standard
+// containers. Other types are estimated by the size of their serialization,
+// which the manager takes from the serialization it already does to store or
+// load the result, so the object isn't serialized just to be measured. Results
+// stored are counted with sizeof(T) until they are serialized. object_size()
+// may be overloaded for the user's large types in their own namespace.
+//
+// The cache isn't synchronized. The computing unit manager owns one, which must
+// be used while holding the archive mutex.
+
+#ifndef __TASK_DISTRIBUTION__RESULT_CACHE_HPP__
+#define __TASK_DISTRIBUTION__RESULT_CACHE_HPP__
+
+#include "object_archive.hpp"
+
+#include <list>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <type_traits>
+#include <typeindex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "key.hpp"
+
+namespace TaskDistribution {
+  namespace detail {
+    template <class T>
+    struct GenericObjectSize;
+  };
+
+  // Estimates the memory used by the object, including the memory it owns.
+  // Types it doesn't know give a value that serializes the object when
+  // converted to a size.
+  template <class T>
+  typename detail::GenericObjectSize<T>::type object_size(T const& obj);
+
+  // Same, but types estimated by their serialization use the given size of
+  // it, which may be 0 if the object wasn't serialized yet, instead of
+  // serializing the object.
+  template <class T>
+  size_t object_size(T const& obj, size_t serialized_size);
+
+  inline size_t object_size(std::string const& obj);
+
+  template <class T, class Allocator>
+  size_t object_size(std::vector<T, Allocator> const& obj);
+
+  template <class T1, class T2>
+  size_t object_size(std::pair<T1, T2> const& obj);
+
+  template <class T, class Allocator>
+  size_t object_size(std::list<T, Allocator> const& obj);
+
+  template <class K, class Compare, class Allocator>
+  size_t object_size(std::set<K, Compare, Allocator> const& obj);
+
+  template <class K, class T, class Compare, class Allocator>
+  size_t object_size(std::map<K, T, Compare, Allocator> const& obj);
+
+  template <class K, class T, class Hash, class Equal, class Allocator>
+  size_t object_size(
+      std::unordered_map<K, T, Hash, Equal, Allocator> const& obj);
+
+  namespace detail {
+    // Size of objects estimated by their serialization, which is only done
+    // if it's converted.
+    template <class T>
+    struct SerializedObjectSize {
+      T const& obj;
+
+      operator size_t() const {
+        return sizeof(T) + ObjectArchive<Key>::serialize(obj).size();
+      }
+    };
+
+    template <class T>
+    struct GenericObjectSize {
+      typedef typename std::conditional<std::is_trivially_copyable<T>::value,
+              size_t, SerializedObjectSize<T>>::type type;
+
+      static size_t get(T const& obj, std::true_type) { return sizeof(T); }
+
+      static SerializedObjectSize<T> get(T const& obj, std::false_type) {
+        return SerializedObjectSize<T>{obj};
+      }
+    };
+
+    // Memory used by the bookkeeping of each element of node-based
+    // containers, besides the element itself.
+    static size_t const container_node_size = 4 * sizeof(void*);
+
+    template <class Container>
+    size_t node_container_size(Container const& obj) {
+      size_t size = sizeof(obj);
+      for (auto const& it : obj)
+        size += container_node_size + TaskDistribution::object_size(it);
+      return size;
+    }
+  };
+
+  // Whether object_size() estimates T by the size of its serialization, which
+  // also holds for containers of such types.
+  template <class T>
+  struct sized_by_serialization:
+    std::is_same<decltype(object_size(std::declval<T const&>())),
+                 detail::SerializedObjectSize<T>> { };
+
+  template <class T, class Allocator>
+  struct sized_by_serialization<std::vector<T, Allocator>>:
+    sized_by_serialization<T> { };
+
+  template <class T1, class T2>
+  struct sized_by_serialization<std::pair<T1, T2>>:
+    std::integral_constant<bool, sized_by_serialization<T1>::value ||
+                                 sized_by_serialization<T2>::value> { };
+
+  template <class T, class Allocator>
+  struct sized_by_serialization<std::list<T, Allocator>>:
+    sized_by_serialization<T> { };
+
+  template <class K, class Compare, class Allocator>
+  struct sized_by_serialization<std::set<K, Compare, Allocator>>:
+    sized_by_serialization<K> { };
+
+  template <class K, class T, class Compare, class Allocator>
+  struct sized_by_serialization<std::map<K, T, Compare, Allocator>>:
+    sized_by_serialization<std::pair<K const, T>> { };
+
+  template <class K, class T, class Hash, class Equal, class Allocator>
+  struct sized_by_serialization<
+    std::unordered_map<K, T, Hash, Equal, Allocator>>:
+    sized_by_serialization<std::pair<K const, T>> { };
+
+  template <class T>
+  typename detail::GenericObjectSize<T>::type object_size(T const& obj) {
+    return detail::GenericObjectSize<T>::get(obj,
+        std::integral_constant<bool, std::is_trivially_copyable<T>::value>());
+  }
+
+  template <class T>
+  size_t object_size(T const& obj, size_t serialized_size) {
+    if (sized_by_serialization<T>::value)
+      return sizeof(T) + serialized_size;
+    return object_size(obj);
+  }
+
+  inline size_t object_size(std::string const& obj) {
+    return sizeof(obj) + obj.capacity();
+  }
+
+  template <class T, class Allocator>
+  size_t object_size(std::vector<T, Allocator> const& obj) {
+    size_t size = sizeof(obj) + (obj.capacity() - obj.size()) * sizeof(T);
+    if (std::is_trivially_copyable<T>::value)
+      return size + obj.size() * sizeof(T);
+
+    for (auto const& it : obj)
+      size += object_size(it);
+    return size;
+  }
+
+  template <class T1, class T2>
+  size_t object_size(std::pair<T1, T2> const& obj) {
+    size_t size = object_size(obj.first);
+    return size + object_size(obj.second);
+  }
+
+  template <class T, class Allocator>
+  size_t object_size(std::list<T, Allocator> const& obj) {
+    return detail::node_container_size(obj);
+  }
+
+  template <class K, class Compare, class Allocator>
+  size_t object_size(std::set<K, Compare, Allocator> const& obj) {
+    return detail::node_container_size(obj);
+  }
+
+  template <class K, class T, class Compare, class Allocator>
+  size_t object_size(std::map<K, T, Compare, Allocator> const& obj) {
+    return detail::node_container_size(obj);
+  }
+
+  template <class K, class T, class Hash, class Equal, class Allocator>
+  size_t object_size(
+      std::unordered_map<K, T, Hash, Equal, Allocator> const& obj) {
+    return detail::node_container_size(obj) +
+      obj.bucket_count() * sizeof(void*);
+  }
+
+  class ResultCache {
+    public:
+      // The capacity is given in bytes. A capacity of 0 disables the cache.
+      explicit ResultCache(size_t capacity = 64*1024*1024);
+
+      // Copies the result with the given key to ret. Returns false if it
+      // isn't cached with the type T.
+      template <class T>
+      bool get(Key const& key, T& ret);
+
+      // Shares the result with the given key without copying it. Returns
+      // nullptr if it isn't cached with the type T.
+      template <class T>
+      std::shared_ptr<T const> get_shared(Key const& key);
+
+      // Stores a copy of the result with the given key, replacing the previous
+      // one.
+      template <class T>
+      void insert(Key const& key, T const& obj);
+
+      // Stores the result without copying it. The object must not be changed
+      // afterwards.
+      template <class T>
+      void insert(Key const& key, std::shared_ptr<T const> const& obj);
+
+      // Same, but with the size already estimated, as by object_size().
+      template <class T>
+      void insert(Key const& key, T const& obj, size_t size);
+
+      template <class T>
+      void insert(Key const& key, std::shared_ptr<T const> const& obj,
+          size_t size);
+
+      // Changes the size of the result with the given key, if the object
+      // cached is still the one given, as when a better estimate is known
+      // after it's serialized.
+      void resize(Key const& key, void const* object, size_t size);
+
+      // Removes the result with the given key, if it's cached.
+      void remove(Key const& key);
+
+      // Removes every result. This must be done if keys are changed.
+      void clear();
+
+      // Sets the capacity, removing results if needed.
+      void set_capacity(size_t capacity);
+      size_t get_capacity() const;
+
+      // Estimated memory used by the results cached.
+      size_t get_size() const;
+
+      // Number of results cached.
+      size_t get_number_of_results() const;
+
+      // Counters of requests found and not found, and of results removed to
+      // respect the capacity.
+      size_t get_hits() const;
+      size_t get_misses() const;
+      size_t get_evictions() const;
+
+    private:
+      struct Entry {
+        std::shared_ptr<void const> object;
+        std::type_index type;
+        size_t size;
+        std::list<Key>::iterator position;
+      };
+
+      // Finds the entry and marks it as the most recently used. Returns
+      // nullptr and counts a miss if it isn't cached with the given type.
+      Entry* find(Key const& key, std::type_index const& type);
+
+      // Stores the object, evicting older results if needed.
+      void insert_entry(Key const& key,
+          std::shared_ptr<void const> const& object,
+          std::type_index const& type, size_t size);
+
+      // Removes least recently used results until the size fits.
+      void evict(size_t max_size);
+
+      std::unordered_map<Key, Entry> entries_;
+
+      // Keys ordered from the most to the least recently used.
+      std::list<Key> order_;
+
+      size_t capacity_, size_;
+      size_t hits_, misses_, evictions_;
+  };
+
+  template <class T>
+  bool ResultCache::get(Key const& key, T& ret) {
+    Entry* entry = find(key, std::type_index(typeid(T)));
+    if (entry == nullptr)
+      return false;
+
+    ret = *static_cast<T const*>(entry->object.get());
+    return true;
+  }
+
+  template <class T>
+  std::shared_ptr<T const> ResultCache::get_shared(Key const& key) {
+    Entry* entry = find(key, std::type_index(typeid(T)));
+    if (entry == nullptr)
+      return nullptr;
+
+    return std::static_pointer_cast<T const>(entry->object);
+  }
+
+  template <class T>
+  void ResultCache::insert(Key const& key, T const& obj) {
+    insert(key, obj, object_size(obj));
+  }
+
+  template <class T>
+  void ResultCache::insert(Key const& key,
+      std::shared_ptr<T const> const& obj) {
+    insert(key, obj, object_size(*obj));
+  }
+
+  template <class T>
+  void ResultCache::insert(Key const& key, T const& obj, size_t size) {
+    if (size > capacity_)
+      return;
+
+    insert_entry(key, std::make_shared<T const>(obj),
+        std::type_index(typeid(T)), size);
+  }
+
+  template <class T>
+  void ResultCache::insert(Key const& key,
+      std::shared_ptr<T const> const& obj, size_t size) {
+    if (size > capacity_)
+      return;
+
+    insert_entry(key, obj, std::type_index(typeid(T)), size);
+  }
+};
+
+#endif
@@ -22,12 +22,17 @@
 // the implementation of a task has changed.
 //
 // The "run" command just performs the computations, which can happen either
-// with or without MPI.
+// with or without MPI. Without MPI, the option "-j" sets the number of threads
+// used to compute the tasks. The option "--critical-path" runs first the tasks
+// that start the longest chains of dependencies.
 //
 // The current status of tasks is shown by commands "check", "clean" and
 // "invalidate". The command "run" re-prints the table as each task is
 // performed, allowing the user to keep track. The name used to print the table
-// is the name associated with the computing unit.
+// is the name associated with the computing unit. If the time taken by the
+// units was measured in previous runs, the remaining time is also estimated.
+// After running, a summary of the compression of large objects is printed if
+// any was compressed or decompressed.
 //
 // The user must inherit the class described here and provide:
 // 1) the method "create_tasks()", which just creates all tasks to be computed;
@@ -69,6 +74,11 @@ namespace TaskDistribution {
       // Prints the tasks status. This should be called after create_unit_map().
       void print_status();
 
+      // Prints how much the objects stored by every process were compressed
+      // and the time spent, if compression was used.
+      void print_compression_summary(
+          ObjectCompressor::Statistics const& statistics);
+
       // Performs the check command.
       void check();
 
@@ -135,6 +145,7 @@ namespace TaskDistribution {
       po::options_description cmd_args_;
       po::options_description help_args_;
       po::options_description invalidate_args_;
+      po::options_description run_args_;
   };
 };
 
@@ -13,15 +13,22 @@
 //
 // This automatically coerces the task to its type. If the result hasn't been
 // computed yet (maybe because the task manager hasn't run), it is computed
-// locally at the time of coercion.
+// locally at the time of coercion, along with any ancestor without result. The
+// results are stored, so nothing is computed twice.
 //
 // The operator() is provided and behaves like coercing, but some functions,
 // like printf, will give error because they don't implicitly perform type
 // conversion.
+//
+// Results that are vectors of numbers may also be read through view(), which
+// gives an ArrayView of the values instead of a new vector. The view shares the
+// result kept in memory or, for results only in the archive, the bytes loaded,
+// without decoding them into a vector. Loading the bytes still copies them.
 
 #ifndef __TASK_DISTRIBUTION__TASK_HPP__
 #define __TASK_DISTRIBUTION__TASK_HPP__
 
+#include "array_view.hpp"
 #include "key.hpp"
 
 namespace TaskDistribution {
@@ -60,6 +67,10 @@ namespace TaskDistribution {
         return (T)*this;
       }
 
+      // Views the result, which must be a std::vector, without decoding it.
+      template <class U = T>
+      ArrayView<typename U::value_type> view() const;
+
     private:
       friend class TaskManager;
 
@@ -8,11 +8,33 @@
 // As the id of the computing unit is required to call it, a key to it is stored
 // in the entry. This may lead to data duplication (all nodes can create
 // different keys for the same id), but allows faster lookup and transmission.
+//
+// The parents and children of the task are kept inline in the entry while they
+// are few, which avoids two extra archive objects for most tasks. A list that
+// grows past max_inline_family keys is moved to its own archive object, whose
+// key is stored in the entry, and stays there afterwards. Entries stored before
+// lists could be inline always have their lists in separate objects.
+//
+// Results whose type satisfies stores_inline, which are small and satisfy
+// is_raw_copyable from raw_copyable.hpp, are also kept in the entry, as their
+// bytes, instead of in their own object. In this case, the result key is
+// invalid and has_result() must be used to check if the task was computed. As
+// with the fast codec, types with padding are excluded, so that equal values
+// give equal entries. The trait may be specialized as false for types whose
+// bytes shouldn't be stored.
 
 #ifndef __TASK_DISTRIBUTION__TASK_ENTRY_HPP__
 #define __TASK_DISTRIBUTION__TASK_ENTRY_HPP__
 
+#include <boost/assert.hpp>
+#include <boost/serialization/array.hpp>
+#include <boost/serialization/version.hpp>
+#include <cstring>
+#include <type_traits>
+
+#include "flat_key_set.hpp"
 #include "key.hpp"
+#include "raw_copyable.hpp"
 
 namespace TaskDistribution {
   // Archive entry for a task, having all values required work with it.
@@ -25,12 +47,63 @@ namespace TaskDistribution {
     Key computing_unit_id_key; // Key to the unit id
     Key parents_key;           // Key to a list of keys of parent tasks
     Key children_key;          // Key to a list of keys of children tasks
-    size_t active_parents;     // Number of parents that have to be computed
+    size_t active_parents;     // Number of parents without result at creation
     bool run_locally;
+    FlatKeySet parents;        // Parents, if parents_key is invalid
+    FlatKeySet children;       // Children, if children_key is invalid
+
+    // Largest list kept inline.
+    static size_t const max_inline_family = 16;
+
+    // Bytes of the result, if it's kept inline.
+    static size_t const max_inline_result = 16;
+    unsigned char inline_result_size;
+    char inline_result[max_inline_result];
 
     TaskEntry():
       active_parents(0),
-      run_locally(false) { }
+      run_locally(false),
+      inline_result_size(0) { }
+
+    bool has_result() const {
+      return result_key.is_valid() || inline_result_size != 0;
+    }
+
+    void clear_result() {
+      result_key = Key();
+      inline_result_size = 0;
+    }
+
+    bool operator==(TaskEntry const& other) const {
+      return task_key == other.task_key &&
+        computing_unit_key == other.computing_unit_key &&
+        arguments_key == other.arguments_key &&
+        arguments_tasks_key == other.arguments_tasks_key &&
+        result_key == other.result_key &&
+        computing_unit_id_key == other.computing_unit_id_key &&
+        parents_key == other.parents_key &&
+        children_key == other.children_key &&
+        active_parents == other.active_parents &&
+        run_locally == other.run_locally &&
+        parents == other.parents &&
+        children == other.children &&
+        inline_result_size == other.inline_result_size &&
+        std::memcmp(inline_result, other.inline_result,
+            inline_result_size) == 0;
+    }
+
+    bool operator!=(TaskEntry const& other) const {
+      return !(*this == other);
+    }
+
+    // Keeps the result inline if its type allows it. Returns false otherwise.
+    template <class T>
+    bool store_inline(T const& result);
+
+    // Copies the result kept inline to ret. Returns false if the result isn't
+    // inline.
+    template <class T>
+    bool load_inline(T& ret) const;
 
     template<class Archive>
     void serialize(Archive& ar, const unsigned int version) {
@@ -44,13 +117,89 @@ namespace TaskDistribution {
       ar & children_key;
       ar & active_parents;
       ar & run_locally;
+      // Older entries don't have inline lists or results
+      if (version > 0) {
+        ar & parents;
+        ar & children;
+      }
+      else if (Archive::is_loading::value) {
+        parents.clear();
+        children.clear();
+      }
+
+      if (version > 1) {
+        ar & inline_result_size;
+        ar & boost::serialization::make_array(inline_result,
+            inline_result_size);
+      }
+      else if (Archive::is_loading::value)
+        inline_result_size = 0;
     }
+
+    private:
+      template <class T>
+      bool store_inline(T const& result, std::true_type);
+
+      template <class T>
+      bool store_inline(T const& result, std::false_type) { return false; }
+
+      template <class T>
+      bool load_inline(T& ret, std::true_type) const;
+
+      template <class T>
+      bool load_inline(T& ret, std::false_type) const { return false; }
+  };
+
+  // Estimates the memory used by the entry while it waits to be written.
+  inline size_t object_size(TaskEntry const& entry) {
+    return sizeof(entry) +
+      (entry.parents.size() + entry.children.size()) * sizeof(Key);
+  }
+
+  // Whether results of type T are kept inline in task entries.
+  template <class T>
+  struct stores_inline:
+    std::integral_constant<bool, is_raw_copyable<T>::value &&
+                                 sizeof(T) <= TaskEntry::max_inline_result> {
   };
+
+  // Whether results of type T may be found inline in task entries. Entries
+  // stored before types with padding were excluded may still have them.
+  template <class T>
+  struct loads_inline:
+    std::integral_constant<bool, std::is_trivially_copyable<T>::value &&
+                                 !std::is_pointer<T>::value &&
+                                 sizeof(T) <= TaskEntry::max_inline_result> {
+  };
+
+  template <class T>
+  bool TaskEntry::store_inline(T const& result) {
+    return store_inline(result, stores_inline<T>());
+  }
+
+  template <class T>
+  bool TaskEntry::load_inline(T& ret) const {
+    if (inline_result_size == 0)
+      return false;
+    return load_inline(ret, loads_inline<T>());
+  }
+
+  template <class T>
+  bool TaskEntry::store_inline(T const& result, std::true_type) {
+    std::memcpy(inline_result, &result, sizeof(T));
+    inline_result_size = sizeof(T);
+    return true;
+  }
+
+  template <class T>
+  bool TaskEntry::load_inline(T& ret, std::true_type) const {
+    BOOST_ASSERT_MSG(inline_result_size == sizeof(T),
+        "inline result has another type");
+    std::memcpy(&ret, inline_result, sizeof(T));
+    return true;
+  }
 };
 
-// Enables faster MPI transmission.
-#if ENABLE_MPI
-BOOST_IS_MPI_DATATYPE(TaskDistribution::TaskEntry);
-#endif
+BOOST_CLASS_VERSION(TaskDistribution::TaskEntry, 2);
 
 #endif
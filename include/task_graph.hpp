@@ -0,0 +1,117 @@
+// The task manager must know, for each task, which children depend on it and
+// how many of its parents are still missing. This file defines the in-memory
+// graph used for this purpose.
+//
+// Each task known by the graph receives a dense index, so that the rest of the
+// information can be stored in plain arrays. Dependencies are first collected
+// as a list of new edges and are compacted, when the children of a task are
+// requested, into a CSR-style adjacency: the children of the task with index i
+// are stored in positions [offset[i], offset[i+1]) of a single array.
+//
+// The number of active parents of each task is kept as an atomic counter, so
+// that finished parents can be reported without any lock. Everything else
+// requires external synchronization.
+//
+// Each task may also have an estimated cost, which is used to compute its
+// bottom level: the cost of the most expensive path from the task to the end of
+// the graph. Running tasks with larger bottom levels first starts long chains
+// of dependencies earlier.
+//
+// The index of the computing unit of each task created in this process is also
+// kept, so that running the task doesn't look its unit up by key.
+
+#ifndef __TASK_DISTRIBUTION__TASK_GRAPH_HPP__
+#define __TASK_DISTRIBUTION__TASK_GRAPH_HPP__
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+#include "key.hpp"
+
+namespace TaskDistribution {
+  class TaskGraph {
+    public:
+      typedef uint32_t Index;
+
+      // Unit index of tasks whose unit isn't known.
+      static size_t const no_unit = size_t(-1);
+
+      // Range of indexes of children of a task, which can be used with a
+      // range-based for.
+      struct Range {
+        Index const* first;
+        Index const* last;
+
+        Index const* begin() const { return first; }
+        Index const* end() const { return last; }
+      };
+
+      // Gets the index for the task, creating a new node if it doesn't exist.
+      Index insert(Key const& task_key);
+
+      // Finds the index for the task. Returns false if the task isn't known.
+      bool find(Key const& task_key, Index& index) const;
+
+      // Gets the key of the task with the given index.
+      Key const& get_key(Index index) const;
+
+      // Number of tasks in the graph.
+      size_t size() const;
+
+      // Adds the dependency between the parent and the child. Repeated edges
+      // are ignored.
+      void add_edge(Index parent, Index child);
+
+      // Sets the number of parents that must finish before the task can run.
+      void set_active_parents(Index index, size_t active_parents);
+
+      // Informs that one parent of the task has finished. Returns true if this
+      // was the last active parent and thus the task is now ready.
+      bool parent_finished(Index index);
+
+      // Gets the children of the task. The range is invalidated if any edge is
+      // added.
+      Range get_children(Index index);
+
+      // Sets the index of the task's computing unit, as given by
+      // BaseComputingUnit::get_index().
+      void set_unit(Index index, size_t unit_index);
+
+      // Gets the index of the task's computing unit, or no_unit if unknown.
+      size_t get_unit(Index index) const;
+
+      // Sets the estimated cost of the task. The default is 1.
+      void set_cost(Index index, double cost);
+
+      // Computes the bottom level of every task. This must be called again if
+      // the graph changes.
+      void compute_bottom_levels();
+
+      // Gets the bottom level computed for the task.
+      double get_bottom_level(Index index) const;
+
+    private:
+      // Merges the new edges into the compact adjacency.
+      void compact();
+
+      std::unordered_map<Key, Index> map_key_to_index_;
+      std::vector<Key> keys_;
+      std::deque<std::atomic<size_t>> active_parents_;
+      std::vector<size_t> units_;
+      std::vector<double> costs_;
+      std::vector<double> bottom_levels_;
+
+      // Compact adjacency. children_offset_ has one more entry than the number
+      // of tasks when it's up to date.
+      std::vector<size_t> children_offset_;
+      std::vector<Index> children_;
+
+      // Edges added after the last compaction.
+      std::vector<std::pair<Index, Index>> new_edges_;
+  };
+};
+
+#endif
@@ -13,6 +13,17 @@ namespace TaskDistribution {
     task_manager_->get_result(task_key_, ret);
     return ret;
   }
+
+  template <class T>
+  template <class U>
+  ArrayView<typename U::value_type> Task<T>::view() const {
+    static_assert(std::is_same<U, std::vector<typename U::value_type>>::value,
+        "only results of type std::vector can be viewed");
+    BOOST_ASSERT_MSG(task_key_.is_valid(), "invalid task key");
+    ArrayView<typename U::value_type> ret;
+    task_manager_->get_result_view(task_key_, ret);
+    return ret;
+  }
 };
 
 #endif
@@ -7,17 +7,55 @@
 // 3) calling a method to load tasks from the archive.
 //
 // Internally, the manager avoids as much data redundancy as it can, which may
-// allow faster execution because of less data transfer.
+// allow faster execution because of less data transfer. Objects are identified
+// by a 128-bit fingerprint of their serialization, which is computed while the
+// object is serialized, so that the serialized string of large objects is only
+// built if the object is new. By default, objects with the same fingerprint
+// still have their bytes compared, but the manager can be told to trust the
+// fingerprints, which avoids loading the stored object.
 //
-// As everything provided is serialized through boost, large arguments, such as
-// matrices, that are used by more than one task should be wrapped in a useless
-// task, called "identity task". This task just has the argument provided as its
-// result and can be used just like the original argument, but the object
-// doesn't need to be serialized, transmitted or stored multiple times.
+// Without MPI, tasks may be created by many threads at the same time. The
+// fingerprints are computed without any lock and are split among shards, each
+// with its own mutex, so that only the archive accesses are serialized.
+//
+// Objects are serialized through boost, except for plain numbers, vectors and
+// tuples of them, which use the fast codec in fast_codec.hpp. Archives written
+// before the codec keep their objects, which are still loaded. Their objects
+// are only known by their stored bytes and, when found again through their
+// serialization by boost, are stored again as encoded by the codec. Once every
+// such object was found, the archive is marked as written with the codec.
+//
+// As everything provided is serialized, large arguments, such as matrices, that
+// are used by more than one task should be wrapped in a useless task, called
+// "identity task". This task just has the argument provided as its result and
+// can be used just like the original argument, but the object doesn't need to
+// be serialized, transmitted or stored multiple times.
+//
+// The children of each task are also stored in the archive, but new children
+// are kept in memory and added to the stored lists only when they are flushed,
+// so that creating many children of a task doesn't store its list many times.
+// The other objects changed by a task's creation are stored together through an
+// ArchiveBatch, defined in archive_batch.hpp, which skips the entries that
+// didn't change, as is usual when tasks in the archive are created again.
 //
 // A task is created by just provind the computing unit that will process the
 // arguments and the arguments themselves.
 //
+// Ready tasks are run in the order they become ready by default. With critical
+// path scheduling, tasks that start the most expensive chains of dependencies
+// are run first, using the costs estimated for each computing unit. Unless set
+// by the user, the cost of a unit is its mean time in the cost model, which is
+// stored in the archive after each run.
+//
+// Without MPI, the tasks can still be run in parallel by setting the number of
+// threads used. Each thread takes a ready task, computes it and releases its
+// children when they are ready. Handlers are always called from one thread at a
+// time.
+//
+// The result of a task can also be requested before it's run. In this case,
+// the task and all its ancestors without result are computed, each only once
+// and using the same threads, and their results are stored as if they were run.
+//
 // The user can provide handlers for 3 kinds of events:
 // 1) new task created;
 // 2) task started;
@@ -34,17 +72,48 @@
 
 #include "function_traits.hpp"
 #include "object_archive.hpp"
+#include "sequence.hpp"
 
+#include "archive_batch.hpp"
 #include "computing_unit_manager.hpp"
+#include "fast_codec.hpp"
+#include "fingerprint.hpp"
+#include "flat_key_set.hpp"
 #include "key.hpp"
+#include "partial_tuple.hpp"
+#include "ready_queue.hpp"
+#include "task_graph.hpp"
 
+#include <array>
+#include <atomic>
+#include <condition_variable>
 #include <functional>
+#include <mutex>
+#include <tuple>
+#include <type_traits>
 
 namespace TaskDistribution {
   // Avoids some cyclic dependencies.
   template <class T> class Task;
   struct TaskEntry;
 
+  // Whether every type is default-constructible.
+  template <class... Types>
+  struct all_default_constructible: std::true_type { };
+
+  template <class T, class... Types>
+  struct all_default_constructible<T, Types...>:
+    std::integral_constant<bool, std::is_default_constructible<T>::value &&
+                                 all_default_constructible<Types...>::value>
+  { };
+
+  template <class Tuple>
+  struct all_default_constructible_tuple;
+
+  template <class... Types>
+  struct all_default_constructible_tuple<std::tuple<Types...>>:
+    all_default_constructible<Types...> { };
+
   class TaskManager {
     public:
       // Handler types.
@@ -52,12 +121,19 @@ namespace TaskDistribution {
         creation_handler_type;
       typedef std::function<void (Key const&)> action_handler_type;
 
+      // Order used to run ready tasks.
+      enum Scheduling {
+        FirstInFirstOut = 0,
+        CriticalPath
+      };
+
       TaskManager(ObjectArchive<Key>& archive,
           ComputingUnitManager& unit_manager);
 
       virtual ~TaskManager();
 
-      // Creates a task for the unit and arguments provided.
+      // Creates a task for the unit and arguments provided. Without MPI, this
+      // may be called by many threads at the same time.
       template <class Unit, class... Args>
       Task<typename CompileUtils::function_traits<Unit>::return_type>
       new_task(Unit const& computing_unit, Args const&... args);
@@ -78,6 +154,54 @@ namespace TaskDistribution {
       // Id of this manager, which is 0 for non-parallel approaches.
       virtual size_t id() const;
 
+      // Number of threads used to run tasks locally. The default is 1, which
+      // runs everything in the calling thread.
+      void set_number_of_threads(size_t n_threads);
+      size_t get_number_of_threads() const;
+
+      // Number of tasks that may run at the same time.
+      virtual size_t get_number_of_workers() const;
+
+      // Model of the time taken by each unit's tasks.
+      CostModel const& get_cost_model() const;
+
+      // Cache of results loaded.
+      ResultCache& get_result_cache();
+
+      // Compressor of large arguments and results. Thresholds must be set
+      // before tasks are created.
+      ObjectCompressor& get_compressor();
+
+      // Statistics of the compression done by every process. With MPI, it
+      // must be called by every process, and only the master gets the sum.
+      virtual ObjectCompressor::Statistics get_compression_statistics();
+
+      // Removes the results and computing units kept in memory. This must be
+      // done if keys are changed without the manager.
+      void clear_caches();
+
+      // Chooses the order used to run ready tasks. Defaults to
+      // FirstInFirstOut.
+      void set_scheduling(Scheduling scheduling);
+      Scheduling get_scheduling() const;
+
+      // Sets the estimated cost of each task of the unit with the given id,
+      // which must be done before its tasks are created. The default cost is
+      // the mean time in the cost model or 1 if the unit isn't in the model.
+      void set_unit_cost(std::string const& unit_id, double cost);
+      double get_unit_cost(std::string const& unit_id) const;
+
+      // Archive operations done to create tasks, including their objects and
+      // the children lists stored when flushed, and the number of tasks
+      // created. Their ratio gives the operations per task.
+      ArchiveOperations get_creation_operations() const;
+      size_t get_number_of_tasks_created() const;
+
+      // Whether objects with the same fingerprint are considered equal without
+      // comparing their bytes. Defaults to false.
+      void set_trust_fingerprints(bool trust_fingerprints);
+      bool get_trust_fingerprints() const;
+
       // Defines the user-provided handlers. The default behavior is to do
       // nothing.
       void set_task_creation_handler(creation_handler_type handler);
@@ -90,65 +214,273 @@ namespace TaskDistribution {
       void clear_task_end_handler();
 
       // Loads all tasks stored in the archive provided. This should be called
-      // only once.
+      // only once. The fingerprints of the objects are restored from the index
+      // saved in the archive and only missing ones are computed.
       void load_archive();
 
+      // Saves the fingerprints of the objects in the archive, so that the next
+      // load_archive() doesn't have to compute them. Does nothing if no object
+      // was created since the last save.
+      void save_archive_index();
+
+      // Removes the saved fingerprints. This must be called if objects are
+      // changed or moved without the manager.
+      void remove_archive_index();
+
+      // Saves the cost model in the archive. This is done after every run.
+      void save_cost_model();
+
+      // Stores the children added to each task since the last flush. The
+      // children lists in the archive may miss tasks until then, which is
+      // done before running tasks, when saving the archive index and when
+      // the manager is destroyed. Must not be called while tasks run, as
+      // their entries are stored again when they finish.
+      void flush_family_lists();
+
+      // Gets the parents or children of a task, wherever they are stored.
+      void load_parents(TaskEntry const& entry, FlatKeySet& parents);
+      void load_children(TaskEntry const& entry, FlatKeySet& children);
+
     protected:
       // Creates an invalid task for a given computing unit.
       template <class Unit>
       Task<typename CompileUtils::function_traits<Unit>::return_type>
       new_invalid_task(Unit const& computing_unit);
 
-      // Runs locally until there are not more tasks.
-      void run_single();
+      // Runs locally the tasks in the queue, using the number of threads set,
+      // until the queue is empty and no task is running. The end handler is
+      // called, with the archive mutex locked, after each task and may push
+      // more tasks to the queue. Tasks that already have a result, such as
+      // the ones computed on demand after being queued, aren't run and only
+      // have the skip handler called.
+      void run_tasks(ReadyQueue& queue,
+          action_handler_type const& begin_handler,
+          action_handler_type const& end_handler,
+          action_handler_type const& skip_handler);
+
+      // Body of each thread created by run_tasks().
+      void run_tasks_worker(ReadyQueue& queue,
+          action_handler_type const& begin_handler,
+          action_handler_type const& end_handler,
+          action_handler_type const& skip_handler, size_t& n_running,
+          std::condition_variable_any& ready_condition);
 
       // Processes the end of a task, evaluating if its children may run.
       void task_completed(Key const& task_key);
 
+      // Pushes the children of the task that become ready to the queue.
+      void release_children(Key const& task_key);
+
+      // Computes the task and every ancestor without result, each only once
+      // and with independent tasks running in parallel.
+      void compute_on_demand(Key const& task_key);
+
+      // Prepares the queue of ready tasks for the scheduling chosen. Must be
+      // called before running the tasks.
+      void prepare_ready_queue();
+
+      // Gets the priority of the task in the queue of ready tasks.
+      double get_priority(Key const& task_key) const;
+
       // Loads the string associated with a key to be hashed. This is required
       // because task entries change and must be restored to their original
       // states.
       std::string load_string_to_hash(Key const& key);
 
+      // Clears the entry's fields that change after the task is created.
+      void clear_entry_state(TaskEntry& entry);
+
       // Updates the keys used in the archive, so that new keys don't conflict.
       virtual void update_used_keys(std::map<int, size_t> const& used_keys);
 
       // Checks if the given data already has a local key. If it does, returns
       // it. Otherwise, creates a new key and inserts it into the archive. This
       // is useful to avoid having lots of similar data with differente keys.
+      // If create is false, an invalid key is returned instead of creating one.
+      // New objects are compressed with the threshold of the given unit.
       template <class T>
-      Key get_key(T const& data, Key::Type type);
+      Key get_key(T const& data, Key::Type type, bool create = true,
+          std::string const& unit_id = std::string());
+
+      // Gets the key of the arguments given as values, as get_key(). Archives
+      // written before only these were stored have the full tuple of
+      // arguments instead, with default values in the positions of tasks,
+      // which is also found and stored again as the arguments given.
+      template <class Tuple, class StoredTuple, class... Args>
+      Key get_arguments_key(
+          StoredArguments<Tuple, StoredTuple> const& arguments,
+          std::string const& unit_id, Args const&... args);
+
+      // Finds the key of the full tuple of arguments stored by older
+      // archives, moving it to the fingerprint of the arguments stored now,
+      // whose serialization is data_str. Tuples with types that aren't
+      // default-constructible couldn't be stored that way.
+      template <class Tuple, class... Args>
+      Key find_full_arguments_key(Fingerprint const& fingerprint,
+          std::string const& data_str, std::string const& unit_id,
+          std::true_type, Args const&... args);
+
+      template <class Tuple, class... Args>
+      Key find_full_arguments_key(Fingerprint const& fingerprint,
+          std::string const& data_str, std::string const& unit_id,
+          std::false_type, Args const&... args);
+
+      typedef std::unordered_multimap<Fingerprint, Key> FingerprintMap;
+
+      // Part of the fingerprints map with its own mutex.
+      struct FingerprintShard {
+        std::mutex mutex;
+        FingerprintMap map;
+      };
+
+      static size_t const n_fingerprint_shards = 16;
+
+      // Largest serialization kept while fingerprinting an object.
+      static size_t const max_kept_serialization = 4096;
+      typedef std::array<FingerprintShard, n_fingerprint_shards>
+        FingerprintShards;
+
+      // Gets the shard where the fingerprint is stored.
+      static FingerprintShard& get_shard(FingerprintShards& shards,
+          Fingerprint const& fingerprint);
+
+      // Computes the fingerprint of the data. Objects handled by the fast
+      // codec have their encoding streamed into the hasher.
+      template <class T>
+      static Fingerprint get_fingerprint(T const& data, std::string& data_str);
+      static Fingerprint get_fingerprint(TaskEntry const& data,
+          std::string& data_str);
+
+      template <class T>
+      static Fingerprint get_fingerprint(T const& data, std::string& data_str,
+          std::true_type);
+      template <class T>
+      static Fingerprint get_fingerprint(T const& data, std::string& data_str,
+          std::false_type);
+
+      // Computes the fingerprint of the data serialized through boost, as it
+      // was stored before the fast codec. Objects are streamed into the
+      // hasher, and the serialization of small ones, like the computing units
+      // created with every task, is also kept in data_str, so that it isn't
+      // built again if the object is new and must be stored.
+      template <class T>
+      static Fingerprint get_boost_fingerprint(T const& data,
+          std::string& data_str);
+      static Fingerprint get_boost_fingerprint(std::string const& data,
+          std::string& data_str);
+
+      // Finds the key of the data, given its fingerprint and maybe its
+      // serialization, creating it if required.
+      template <class T>
+      Key find_or_create_key(T const& data, Fingerprint const& fingerprint,
+          std::string& data_str, Key::Type type, bool create,
+          std::string const& unit_id);
+
+      // Finds the key of the data among the objects only known by the
+      // fingerprint of data_str, their stored bytes, and moves it to the shard
+      // under the data's fingerprint. Returns an invalid key if not found. The
+      // shard's mutex must be held.
+      template <class T>
+      Key take_bytes_key(FingerprintShard& shard,
+          Fingerprint const& fingerprint, T const& data,
+          std::string& data_str);
+
+      // Stores the object again with its current encoding, compressed with
+      // the threshold of the given unit, counting the operations done.
+      void store_again(Key const& key, std::string data_str,
+          std::string const& unit_id);
+
+      // Finds the key in the map whose object is equal to data. The
+      // serialization of data is stored in data_str if it's required for the
+      // comparison and data_str is empty. Returns map.end() if not found. The
+      // map's mutex must be held.
+      template <class T>
+      FingerprintMap::iterator find_key(FingerprintMap& map,
+          Fingerprint const& fingerprint, T const& data,
+          std::string& data_str);
 
       // Creates a new key of a given type.
       virtual Key new_key(Key::Type type);
 
-      // Creates children and parents if they are invalid.
-      void create_family_lists(TaskEntry& entry);
+      // Sets the list of parents or children of an entry, given by its inline
+      // list and its key, moving it to its own object if it's too large.
+      void store_family_list(FlatKeySet list, FlatKeySet& inline_list,
+          Key& list_key, Key::Type type, ArchiveBatch& batch);
+
+      // Same as load_parents and load_children, through the batch.
+      void load_parents(TaskEntry const& entry, FlatKeySet& parents,
+          ArchiveBatch& batch);
+      void load_children(TaskEntry const& entry, FlatKeySet& children,
+          ArchiveBatch& batch);
 
-      // Creates the bilateral link between child and parent task.
+      // Creates the bilateral link between child and parent task, counting the
+      // parent as active if it doesn't have a result.
       void add_dependency(TaskEntry& child_entry, Key const& parent_key,
-          KeySet& parents);
+          FlatKeySet& parents, ArchiveBatch& batch);
 
       // Gets the result for a given task.
       template <class> friend class Task;
       template <class T>
       void get_result(Key const& task_key, T& ret);
 
+      // Views the result for a given task, which is a std::vector<T>.
+      template <class T>
+      void get_result_view(Key const& task_key, ArrayView<T>& view);
+
       ObjectArchive<Key>& archive_;
       ComputingUnitManager& unit_manager_;
 
       creation_handler_type task_creation_handler_;
       action_handler_type task_begin_handler_, task_end_handler_;
 
-      // Maps object hashes to their keys, to avoid duplicated objects.
-      std::unordered_multimap<size_t, Key> map_hash_to_key_;
+      // Maps object fingerprints to their keys, to avoid duplicated objects.
+      FingerprintShards map_hash_to_key_;
+
+      // Maps fingerprints of the stored bytes to keys, for objects whose
+      // fingerprint wasn't saved and whose type isn't known. They are moved to
+      // map_hash_to_key_ when found again. A shard of map_hash_to_key_ may be
+      // locked before a shard of this map, but not the opposite.
+      FingerprintShards map_bytes_hash_to_key_;
+      std::atomic<size_t> n_bytes_hashes_;
+      bool trust_fingerprints_;
+
+      // Whether the archive was written before the fast codec, so that the
+      // objects only known by their bytes may have been serialized through
+      // boost instead.
+      bool legacy_encodings_;
+
+      // Whether the fingerprint maps differ from the index saved in the
+      // archive.
+      std::atomic<bool> archive_index_changed_;
+
+      // Dependencies between tasks. This is stored in the archive, but a
+      // compact copy is kept here for faster dependency analysis, so that
+      // children don't have to be loaded when their parents finish. Like the
+      // queue, it's protected by the archive mutex.
+      TaskGraph graph_;
 
-      // Maps tasks to their children. This is store in the archive, but a copy
-      // is kept here for faster dependency analysis.
-      std::unordered_map<Key, KeySet> map_task_to_children_;
+      // Children added to each task, by the task's key, since the last
+      // flush. Protected by the archive mutex.
+      std::unordered_map<Key, KeyList> new_children_;
 
-      // List of tasks that are ready to compute.
-      KeyList ready_;
+      // Number of tasks whose children lists are stored by each batch of a
+      // flush, so that the copies kept by the batch don't grow with the flush.
+      static size_t const family_flush_chunk_size = 1024;
+
+      // Archive operations done to create tasks. Protected by the archive
+      // mutex.
+      ArchiveOperations creation_operations_;
+      size_t n_tasks_created_;
+
+      // Queue of tasks that are ready to compute.
+      ReadyQueue ready_;
+      Scheduling scheduling_;
+
+      // Estimated cost of the tasks of each unit.
+      std::unordered_map<std::string, double> unit_costs_;
+
+      // Number of threads used locally.
+      size_t n_threads_;
 
 
       // Auxiliary methods to build argument tuples tuples.
@@ -157,10 +489,26 @@ namespace TaskDistribution {
       template <class T>
       static T get_value(T const& arg);
 
-      // Returns an empty value T.
+      // Returns an empty value T, as stored by older archives.
       template <class T>
       static T get_value(Task<T> const& arg);
 
+      // Returns a tuple with the argument as the type T, referencing it if
+      // it already has this type.
+      template <class T, class Arg>
+      static typename std::enable_if<std::is_same<T, Arg>::value,
+             std::tuple<T const&>>::type
+      get_stored_value(Arg const& arg);
+
+      template <class T, class Arg>
+      static typename std::enable_if<!std::is_same<T, Arg>::value,
+             std::tuple<T>>::type
+      get_stored_value(Arg const& arg);
+
+      // Returns an empty tuple, as tasks aren't stored.
+      template <class T, class U>
+      static std::tuple<> get_stored_value(Task<U> const& arg);
+
       // Returns an empty key.
       template <class T>
       static Key get_task_key(T const& arg);
@@ -169,10 +517,18 @@ namespace TaskDistribution {
       template <class T>
       static Key get_task_key(Task<T> const& arg);
 
-      // Builds the tuple with only the value of arguments that aren't tasks.
+      // Builds the full tuple of arguments, as stored by older archives.
       template <class Tuple, class... Args>
       static Tuple make_args_tuple(Args const&... args);
 
+      // Builds the tuple with only the arguments that aren't tasks, as the
+      // types of Tuple at the same positions.
+      template <class Tuple, size_t... S, class... Args>
+      static auto make_stored_args_tuple(CompileUtils::sequence<S...>,
+          Args const&... args) -> decltype(std::tuple_cat(
+            get_stored_value<typename std::tuple_element<S, Tuple>::type>(
+              args)...));
+
       // Builds the tuple with only the keys to tasks arguments.
       template <class Tuple, class... Args>
       static Tuple make_args_tasks_tuple(Args const&... args);
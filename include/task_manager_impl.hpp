@@ -8,6 +8,7 @@
 #include "task_manager.hpp"
 
 #include "computing_unit.hpp"
+#include "partial_tuple.hpp"
 #include "task.hpp"
 
 #include <boost/serialization/set.hpp>
@@ -45,9 +46,15 @@ namespace TaskDistribution {
         "Can't convert from arguments provided to expected."
     );
 
-    // Makes tuples of normal arguments and task arguments
-    unit_args_tuple_type args_tuple(
-        make_args_tuple<unit_args_tuple_type>(args...));
+    // Makes tuples of normal arguments and task arguments. Only arguments
+    // that aren't tasks are stored, which is known from their types.
+    typedef typename CompileUtils::sequence_generator<sizeof...(Args)>::type
+      args_sequence;
+    typedef decltype(make_stored_args_tuple<unit_args_tuple_type>(
+          args_sequence(), args...)) stored_args_tuple_type;
+    StoredArguments<unit_args_tuple_type, stored_args_tuple_type> stored_args(
+        make_stored_args_tuple<unit_args_tuple_type>(args_sequence(),
+          args...));
     args_tasks_tuple_type args_tasks_tuple(
         make_args_tasks_tuple<args_tasks_tuple_type>(args...));
 
@@ -56,8 +63,8 @@ namespace TaskDistribution {
         Key::ComputingUnit);
     Key computing_unit_id_key = get_key(computing_unit.get_id(),
         Key::ComputingUnitId);
-    Key arguments_key = get_key(args_tuple,
-        Key::Arguments);
+    Key arguments_key = get_arguments_key(stored_args,
+        computing_unit.get_id(), args...);
     Key arguments_tasks_key = get_key(args_tasks_tuple,
         Key::ArgumentsTasks);
 
@@ -69,43 +76,47 @@ namespace TaskDistribution {
     task_entry.arguments_tasks_key = arguments_tasks_key;
     task_entry.run_locally = computing_unit.run_locally();
 
-    // Stores task entry and update its internal data
+    // Stores task entry and update its internal data. Everything after the
+    // entry is found depends on other tasks, so it's done with the archive
+    // locked.
     Key task_key = get_key(task_entry, Key::Task);
-    archive_.load(task_key, task_entry);
+    std::lock_guard<std::recursive_mutex> lock(
+        unit_manager_.get_archive_mutex());
+    ArchiveBatch batch(archive_);
+    batch.load(task_key, task_entry);
     task_entry.task_key = task_key;
 
-    // Creates children and parents if they don't exist
-    create_family_lists(task_entry);
+    // Do dependency analysis. The same task may be given more than once.
+    FlatKeySet dependencies({get_task_key(args)...});
 
-    // Do dependency analysis
-    KeyList dependencies({get_task_key(args)...});
-
-    // Add dependencies
-    KeySet parents;
-    archive_.load(task_entry.parents_key, parents);
+    // Add dependencies, counting again the active parents as some may have
+    // finished since the entry was stored
+    FlatKeySet parents;
+    load_parents(task_entry, parents, batch);
 
+    task_entry.active_parents = 0;
     for (auto& parent_key: dependencies)
       if (parent_key.is_valid())
-        add_dependency(task_entry, parent_key, parents);
+        add_dependency(task_entry, parent_key, parents, batch);
 
-    archive_.insert(task_entry.parents_key, parents);
+    store_family_list(std::move(parents), task_entry.parents,
+        task_entry.parents_key, Key::Parents, batch);
 
-    // Check if task can and should be run now
-    if (task_entry.active_parents == 0 && !task_entry.result_key.is_valid()) {
-      bool found = false;
-      for (auto& key : ready_) {
-        if (key == task_key) {
-          found = true;
-          break;
-        }
-      }
+    TaskGraph::Index task_index = graph_.insert(task_key);
+    graph_.set_active_parents(task_index, task_entry.active_parents);
+    graph_.set_unit(task_index, computing_unit.get_index());
+    graph_.set_cost(task_index, get_unit_cost(computing_unit.get_id()));
 
-      // If task doesn't exist already, add it to the list
-      if (!found)
-        ready_.push_back(task_key);
-    }
+    // Check if task can and should be run now. If the task is already in the
+    // queue, it isn't added again.
+    if (task_entry.active_parents == 0 && !task_entry.has_result())
+      ready_.push(task_key, 0, task_index);
 
-    archive_.insert(task_key, task_entry);
+    // Tasks created again usually don't change, so nothing is written
+    batch.insert(task_key, task_entry);
+    batch.commit();
+    creation_operations_ += batch.get_operations();
+    n_tasks_created_++;
 
     // Informs the handler that a new task was created.
     task_creation_handler_(computing_unit.get_id(), task_key);
@@ -122,15 +133,37 @@ namespace TaskDistribution {
       return Task<T>(Key(), this);
 
     // Creates a degenerate task that only has a result.
-    Key result_key = get_key(arg, Key::Result);
     TaskEntry task_entry;
-    task_entry.result_key = result_key;
     task_entry.run_locally = false;
+    Key task_key;
+    if (!task_entry.store_inline(arg)) {
+      task_entry.result_key = get_key(arg, Key::Result, true, "identity");
+      task_key = get_key(task_entry, Key::Task);
+    }
+    else {
+      // Archives stored before small values were inline have them in result
+      // objects, so an equal task may exist with the value's key instead
+      task_key = get_key(task_entry, Key::Task, false);
+      if (!task_key.is_valid()) {
+        TaskEntry stored_entry;
+        stored_entry.result_key = get_key(arg, Key::Result, false);
+        if (stored_entry.result_key.is_valid())
+          task_key = get_key(stored_entry, Key::Task, false);
+      }
 
-    Key task_key = get_key(task_entry, Key::Task);
-    archive_.load(task_key, task_entry);
+      if (!task_key.is_valid())
+        task_key = get_key(task_entry, Key::Task);
+    }
+
+    std::lock_guard<std::recursive_mutex> lock(
+        unit_manager_.get_archive_mutex());
+    ArchiveBatch batch(archive_);
+    batch.load(task_key, task_entry);
     task_entry.task_key = task_key;
-    archive_.insert(task_key, task_entry);
+    batch.insert(task_key, task_entry);
+    batch.commit();
+    creation_operations_ += batch.get_operations();
+    n_tasks_created_++;
 
     task_creation_handler_("identity", task_key);
 
@@ -150,39 +183,217 @@ namespace TaskDistribution {
   }
 
   template <class T>
-  Key TaskManager::get_key(T const& data, Key::Type type) {
-    std::string data_str = ObjectArchive<Key>::serialize(data);
-    std::hash<std::string> hasher;
-    size_t hash = hasher(data_str);
-    auto range = map_hash_to_key_.equal_range(hash);
+  Key TaskManager::get_key(T const& data, Key::Type type, bool create,
+      std::string const& unit_id) {
+    // Only built if required
+    std::string data_str;
+    Fingerprint fingerprint = get_fingerprint(data, data_str);
+    return find_or_create_key(data, fingerprint, data_str, type, create,
+        unit_id);
+  }
+
+  template <class Tuple, class StoredTuple, class... Args>
+  Key TaskManager::get_arguments_key(
+      StoredArguments<Tuple, StoredTuple> const& arguments,
+      std::string const& unit_id, Args const&... args) {
+    std::string data_str;
+    Fingerprint fingerprint = get_fingerprint(arguments, data_str);
+
+    if (legacy_encodings_) {
+      Key key = find_or_create_key(arguments, fingerprint, data_str,
+          Key::Arguments, false, unit_id);
+      if (key.is_valid())
+        return key;
+
+      if (n_bytes_hashes_ != 0) {
+        if (data_str.empty())
+          data_str = serialize_object(arguments);
+
+        key = find_full_arguments_key<Tuple>(fingerprint, data_str, unit_id,
+            all_default_constructible_tuple<Tuple>(), args...);
+        if (key.is_valid())
+          return key;
+      }
+    }
+
+    return find_or_create_key(arguments, fingerprint, data_str,
+        Key::Arguments, true, unit_id);
+  }
+
+  template <class Tuple, class... Args>
+  Key TaskManager::find_full_arguments_key(Fingerprint const& fingerprint,
+      std::string const& data_str, std::string const& unit_id,
+      std::true_type, Args const&... args) {
+    Tuple full_tuple(make_args_tuple<Tuple>(args...));
+    std::string full_data_str = ObjectArchive<Key>::serialize(full_tuple);
+
+    FingerprintShard& shard = get_shard(map_hash_to_key_, fingerprint);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    Key key = take_bytes_key(shard, fingerprint, full_tuple, full_data_str);
+    if (key.is_valid())
+      store_again(key, data_str, unit_id);
+    return key;
+  }
+
+  template <class Tuple, class... Args>
+  Key TaskManager::find_full_arguments_key(Fingerprint const& fingerprint,
+      std::string const& data_str, std::string const& unit_id,
+      std::false_type, Args const&... args) {
+    return Key();
+  }
+
+  template <class T>
+  Key TaskManager::find_or_create_key(T const& data,
+      Fingerprint const& fingerprint, std::string& data_str, Key::Type type,
+      bool create, std::string const& unit_id) {
+    // The shard stays locked until the key is known, so that other threads
+    // can't create the same object
+    FingerprintShard& shard = get_shard(map_hash_to_key_, fingerprint);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto it = find_key(shard.map, fingerprint, data, data_str);
+    if (it != shard.map.end())
+      return it->second;
+
+    // Checks objects only known by their bytes
+    if (n_bytes_hashes_ != 0) {
+      if (data_str.empty())
+        data_str = serialize_object(data);
+
+      Key key = take_bytes_key(shard, fingerprint, data, data_str);
+      if (key.is_valid())
+        return key;
+
+      // Older archives may have the object serialized through boost, which is
+      // stored again as encoded by the fast codec, so that it's found by its
+      // fingerprint from now on
+      if (FastCodec<T>::enabled && legacy_encodings_) {
+        std::string boost_data_str = ObjectArchive<Key>::serialize(data);
+        key = take_bytes_key(shard, fingerprint, data, boost_data_str);
+        if (key.is_valid()) {
+          store_again(key, data_str, unit_id);
+          return key;
+        }
+      }
+    }
+
+    if (!create)
+      return Key();
+
+    // If no correct entry was found, create new key and store the data. Task
+    // entries are updated in place by batches, so they aren't compressed.
+    if (data_str.empty())
+      data_str = serialize_object(data);
+    if (type != Key::Task)
+      unit_manager_.get_compressor().compress(data_str, unit_id);
+
+    Key key = new_key(type);
+    shard.map.emplace(fingerprint, key);
+    archive_index_changed_ = true;
+
+    std::lock_guard<std::recursive_mutex> archive_lock(
+        unit_manager_.get_archive_mutex());
+    archive_.insert_raw(key, std::move(data_str));
+    creation_operations_.n_inserts++;
+    creation_operations_.n_writes++;
+    return key;
+  }
+
+  template <class T>
+  Fingerprint TaskManager::get_fingerprint(T const& data,
+      std::string& data_str) {
+    return get_fingerprint(data, data_str,
+        std::integral_constant<bool, FastCodec<T>::enabled>());
+  }
+
+  template <class T>
+  Fingerprint TaskManager::get_fingerprint(T const& data,
+      std::string& data_str, std::true_type) {
+    FingerprintHasher hasher;
+    fast_write(hasher, data);
+    return hasher.finish();
+  }
+
+  template <class T>
+  Fingerprint TaskManager::get_fingerprint(T const& data,
+      std::string& data_str, std::false_type) {
+    return get_boost_fingerprint(data, data_str);
+  }
+
+  template <class T>
+  Fingerprint TaskManager::get_boost_fingerprint(T const& data,
+      std::string& data_str) {
+    return Fingerprint::of_object(data, data_str, max_kept_serialization);
+  }
+
+  template <class T>
+  Key TaskManager::take_bytes_key(FingerprintShard& shard,
+      Fingerprint const& fingerprint, T const& data, std::string& data_str) {
+    Fingerprint bytes_fingerprint = Fingerprint::of(data_str);
+    FingerprintShard& bytes_shard = get_shard(map_bytes_hash_to_key_,
+        bytes_fingerprint);
+    std::lock_guard<std::mutex> bytes_lock(bytes_shard.mutex);
+
+    auto it = find_key(bytes_shard.map, bytes_fingerprint, data, data_str);
+    if (it == bytes_shard.map.end())
+      return Key();
+
+    Key key = it->second;
+    bytes_shard.map.erase(it);
+    n_bytes_hashes_--;
+    shard.map.emplace(fingerprint, key);
+    archive_index_changed_ = true;
+    return key;
+  }
+
+  template <class T>
+  TaskManager::FingerprintMap::iterator TaskManager::find_key(
+      FingerprintMap& map, Fingerprint const& fingerprint, T const& data,
+      std::string& data_str) {
+    auto range = map.equal_range(fingerprint);
 
     // Process found keys
     for (auto it = range.first; it != range.second; ++it) {
+      if (trust_fingerprints_)
+        return it;
+
+      if (data_str.empty())
+        data_str = serialize_object(data);
+
       std::string other_data_str = load_string_to_hash(it->second);
       if (data_str == other_data_str)
-          return it->second;
+          return it;
     }
 
-    // If no correct entry was found, create new key and store the data
-    Key key = new_key(type);
-    map_hash_to_key_.emplace(hash, key);
-    archive_.insert_raw(key, std::move(data_str));
-    return key;
+    return map.end();
   }
 
   template <class T>
   void TaskManager::get_result(Key const& task_key, T& ret) {
     TaskEntry entry;
-    archive_.load(task_key, entry);
+    unit_manager_.load_entry(task_key, entry);
+
+    // If the task hasn't been computed, compute it now with its ancestors.
+    if (!entry.has_result()) {
+      compute_on_demand(task_key);
+      unit_manager_.load_entry(task_key, entry);
+    }
 
-    // If the task hasn't been computed, compute it now.
-    if (!entry.result_key.is_valid())
-      unit_manager_.process_local(entry);
+    unit_manager_.load_result(entry, ret);
+  }
+
+  template <class T>
+  void TaskManager::get_result_view(Key const& task_key, ArrayView<T>& view) {
+    TaskEntry entry;
+    unit_manager_.load_entry(task_key, entry);
 
-    archive_.load(entry.result_key, ret);
+    if (!entry.has_result()) {
+      compute_on_demand(task_key);
+      unit_manager_.load_entry(task_key, entry);
+    }
 
-    if (!entry.result_key.is_valid())
-      archive_.remove(entry.result_key);
+    unit_manager_.load_result_view(entry.result_key, view);
   }
 
   template <class T>
@@ -210,6 +421,34 @@ namespace TaskDistribution {
     return Tuple(get_value(args)...);
   }
 
+  template <class T, class Arg>
+  typename std::enable_if<std::is_same<T, Arg>::value,
+           std::tuple<T const&>>::type
+  TaskManager::get_stored_value(Arg const& arg) {
+    return std::tuple<T const&>(arg);
+  }
+
+  template <class T, class Arg>
+  typename std::enable_if<!std::is_same<T, Arg>::value, std::tuple<T>>::type
+  TaskManager::get_stored_value(Arg const& arg) {
+    return std::tuple<T>(arg);
+  }
+
+  template <class T, class U>
+  std::tuple<> TaskManager::get_stored_value(Task<U> const& arg) {
+    return std::tuple<>();
+  }
+
+  template <class Tuple, size_t... S, class... Args>
+  auto TaskManager::make_stored_args_tuple(CompileUtils::sequence<S...>,
+      Args const&... args) -> decltype(std::tuple_cat(
+        get_stored_value<typename std::tuple_element<S, Tuple>::type>(
+          args)...)) {
+    return std::tuple_cat(
+        get_stored_value<typename std::tuple_element<S, Tuple>::type>(
+          args)...);
+  }
+
   template <class Tuple, class... Args>
   Tuple TaskManager::make_args_tasks_tuple(Args const&... args) {
     return Tuple(get_task_key(args)...);
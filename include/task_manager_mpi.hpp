@@ -5,6 +5,8 @@
 #define __TASK_DISTRIBUTION__TASK_MANAGER_MPI_HPP__
 
 #include <boost/mpi/communicator.hpp>
+#include <chrono>
+#include <unordered_map>
 #include "object_archive_mpi.hpp"
 #include "mpi_handler.hpp"
 
@@ -38,6 +40,12 @@ namespace TaskDistribution {
       // Id of this manager, which is its rank with MPI.
       virtual size_t id() const;
 
+      // Number of slaves, or of threads if running alone.
+      virtual size_t get_number_of_workers() const;
+
+      // Sums the statistics of every process in the master.
+      virtual ObjectCompressor::Statistics get_compression_statistics();
+
     protected:
       // Runs the manager that allocates tasks.
       void run_master();
@@ -60,6 +68,10 @@ namespace TaskDistribution {
       // Sends a finish tag to all other nodes.
       void broadcast_finish();
 
+      // Gives the master's compression thresholds to the slaves, which
+      // compress the results they compute.
+      void broadcast_compression_thresholds();
+
       // Updates the keys used in the archive, so that new keys don't conflict,
       // and sends relevant information for other nodes to update their keys.
       virtual void update_used_keys(std::map<int, size_t> const& used_keys);
@@ -82,6 +94,12 @@ namespace TaskDistribution {
 
       // Number of tasks allocated to each slave.
       std::vector<int> tasks_per_node_;
+
+      // Unit id and start time of the tasks running remotely. The time
+      // measured includes the communication with the slave.
+      std::unordered_map<Key,
+        std::pair<std::string, std::chrono::steady_clock::time_point>>
+        remote_tasks_;
   };
 };
 
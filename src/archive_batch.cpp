@@ -0,0 +1,32 @@
+#include "archive_batch.hpp"
+
+namespace TaskDistribution {
+  ArchiveOperations& ArchiveOperations::operator+=(
+      ArchiveOperations const& other) {
+    n_loads += other.n_loads;
+    n_inserts += other.n_inserts;
+    n_writes += other.n_writes;
+    return *this;
+  }
+
+  ArchiveBatch::ArchiveBatch(ObjectArchive<Key>& archive):
+    archive_(archive) { }
+
+  void ArchiveBatch::commit() {
+    for (auto& key : order_) {
+      Entry const& entry = entries_.at(key);
+      if (!entry.pending)
+        continue;
+
+      entry.write(archive_, key, entry.pending.get());
+      operations_.n_writes++;
+    }
+
+    entries_.clear();
+    order_.clear();
+  }
+
+  ArchiveOperations const& ArchiveBatch::get_operations() const {
+    return operations_;
+  }
+};
@@ -0,0 +1,93 @@
+#include "archive_writer.hpp"
+
+namespace TaskDistribution {
+  ArchiveWriter::ArchiveWriter(ObjectArchive<Key>& archive,
+      std::recursive_mutex& archive_mutex, size_t max_pending_size):
+    archive_(archive),
+    archive_mutex_(archive_mutex),
+    max_pending_size_(max_pending_size),
+    pending_size_(0),
+    stop_(false) { }
+
+  ArchiveWriter::~ArchiveWriter() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    condition_.notify_all();
+
+    if (thread_.joinable())
+      thread_.join();
+  }
+
+  void ArchiveWriter::flush() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!pending_.empty())
+      condition_.wait(lock);
+  }
+
+  void ArchiveWriter::insert_entry(Key const& key, Entry const& entry) {
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    if (!thread_.joinable())
+      thread_ = std::thread(&ArchiveWriter::run, this);
+
+    while (!pending_.empty() &&
+        pending_size_ + entry.size > max_pending_size_)
+      condition_.wait(lock);
+
+    // An object inserted again replaces the pending one. The key is queued
+    // again in case the older object is being written.
+    auto it = pending_.find(key);
+    if (it != pending_.end()) {
+      pending_size_ = pending_size_ - it->second.size + entry.size;
+      it->second = entry;
+    }
+    else {
+      pending_.emplace(key, entry);
+      pending_size_ += entry.size;
+    }
+    queue_.push_back(key);
+    condition_.notify_all();
+  }
+
+  void ArchiveWriter::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    while (1) {
+      while (queue_.empty() && !stop_)
+        condition_.wait(lock);
+
+      // Only stops after writing everything
+      if (queue_.empty())
+        break;
+
+      Key key = queue_.front();
+      queue_.pop_front();
+
+      // Keys queued again may have been written already
+      auto it = pending_.find(key);
+      if (it == pending_.end())
+        continue;
+      Entry entry = it->second;
+
+      lock.unlock();
+      std::string data = entry.serialize();
+      {
+        std::lock_guard<std::recursive_mutex> archive_lock(archive_mutex_);
+        archive_.insert_raw(key, std::move(data));
+      }
+      lock.lock();
+
+      // Only removed after written, so that it can always be found either
+      // here or in the archive. An object inserted again meanwhile is written
+      // when its key is found again in the queue.
+      it = pending_.find(key);
+      if (it->second.object == entry.object) {
+        pending_size_ -= entry.size;
+        pending_.erase(it);
+      }
+      condition_.notify_all();
+    }
+  }
+};
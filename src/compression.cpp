@@ -0,0 +1,281 @@
+#include "compression.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+namespace TaskDistribution {
+  static char const compressed_header[8] =
+    {'T', 'D', 'L', 'Z', '\x01', '\0', '\0', '\0'};
+  static size_t const compressed_prefix_size =
+    sizeof(compressed_header) + sizeof(uint64_t);
+
+  static size_t const min_match = 4;
+  static size_t const max_offset = 65535;
+  static unsigned const hash_bits = 14;
+
+  // Lengths that don't fit the token's 4 bits.
+  static size_t const token_length_limit = 15;
+
+  static uint32_t read32(char const* data) {
+    uint32_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+  }
+
+  static size_t hash32(uint32_t value) {
+    return (value * 2654435761u) >> (32 - hash_bits);
+  }
+
+  // Writes the part of the length that doesn't fit the token, in bytes of
+  // 255 and a last byte smaller than it.
+  static void write_length(std::string& out, size_t length) {
+    length -= token_length_limit;
+    while (length >= 255) {
+      out.push_back(char(255));
+      length -= 255;
+    }
+    out.push_back(char(length));
+  }
+
+  static bool read_length(unsigned char const*& in, unsigned char const* end,
+      size_t& length) {
+    unsigned char byte;
+    do {
+      if (in == end)
+        return false;
+      byte = *in++;
+      length += byte;
+    } while (byte == 255);
+    return true;
+  }
+
+  // Writes the literals followed by the match. The last sequence has no
+  // match, which is given by a match length of 0.
+  static void write_sequence(std::string& out, char const* literals,
+      size_t n_literals, size_t offset, size_t match_length) {
+    size_t match_code = match_length == 0 ? 0 : match_length - min_match;
+    out.push_back(char(
+          (std::min(n_literals, token_length_limit) << 4) |
+          std::min(match_code, token_length_limit)));
+    if (n_literals >= token_length_limit)
+      write_length(out, n_literals);
+    out.append(literals, n_literals);
+
+    if (match_length == 0)
+      return;
+
+    out.push_back(char(offset & 0xff));
+    out.push_back(char(offset >> 8));
+    if (match_code >= token_length_limit)
+      write_length(out, match_code);
+  }
+
+  void lz_compress(char const* data, size_t size, std::string& out) {
+    // Last position where each hash was seen
+    std::vector<size_t> table(size_t(1) << hash_bits, 0);
+
+    char const* end = data + size;
+    char const* anchor = data;
+    char const* in = data;
+    size_t misses = 0;
+
+    while (size_t(end - in) >= min_match) {
+      uint32_t sequence = read32(in);
+      size_t& position = table[hash32(sequence)];
+      char const* match = data + position;
+      position = in - data;
+
+      if (match < in && size_t(in - match) <= max_offset &&
+          read32(match) == sequence) {
+        char const* match_end = in + min_match;
+        match += min_match;
+        while (match_end < end && *match_end == *match) {
+          match_end++;
+          match++;
+        }
+
+        write_sequence(out, anchor, in - anchor, match_end - match,
+            match_end - in);
+        in = anchor = match_end;
+        misses = 0;
+        continue;
+      }
+
+      // Long runs without matches are skipped faster
+      size_t step = 1 + (misses++ >> 6);
+      if (size_t(end - in) < step)
+        break;
+      in += step;
+    }
+
+    write_sequence(out, anchor, end - anchor, 0, 0);
+  }
+
+  bool lz_decompress(char const* data, size_t size, char* out,
+      size_t out_size) {
+    unsigned char const* in = reinterpret_cast<unsigned char const*>(data);
+    unsigned char const* end = in + size;
+    char* out_position = out;
+    char* out_end = out + out_size;
+
+    while (in != end) {
+      unsigned char token = *in++;
+
+      size_t n_literals = token >> 4;
+      if (n_literals == token_length_limit &&
+          !read_length(in, end, n_literals))
+        return false;
+      if (n_literals > size_t(end - in) ||
+          n_literals > size_t(out_end - out_position))
+        return false;
+      std::memcpy(out_position, in, n_literals);
+      out_position += n_literals;
+      in += n_literals;
+
+      // The last sequence has only literals
+      if (in == end)
+        break;
+
+      if (end - in < 2)
+        return false;
+      size_t offset = in[0] | (size_t(in[1]) << 8);
+      in += 2;
+
+      size_t length = token & 0xf;
+      if (length == token_length_limit && !read_length(in, end, length))
+        return false;
+      length += min_match;
+
+      if (offset == 0 || offset > size_t(out_position - out) ||
+          length > size_t(out_end - out_position))
+        return false;
+
+      // Matches may overlap the bytes they produce
+      char const* match = out_position - offset;
+      if (offset >= length)
+        std::memcpy(out_position, match, length);
+      else
+        for (size_t i = 0; i < length; i++)
+          out_position[i] = match[i];
+      out_position += length;
+    }
+
+    return out_position == out_end;
+  }
+
+  ObjectCompressor::ObjectCompressor():
+    threshold_(never),
+    n_compressed_(0),
+    n_incompressible_(0),
+    original_size_(0),
+    compressed_size_(0),
+    n_decompressed_(0),
+    compression_time_(0),
+    decompression_time_(0) { }
+
+  void ObjectCompressor::set_threshold(size_t threshold) {
+    threshold_ = threshold;
+  }
+
+  size_t ObjectCompressor::get_threshold() const {
+    return threshold_;
+  }
+
+  void ObjectCompressor::set_unit_threshold(std::string const& unit_id,
+      size_t threshold) {
+    unit_thresholds_[unit_id] = threshold;
+  }
+
+  size_t ObjectCompressor::get_unit_threshold(
+      std::string const& unit_id) const {
+    auto it = unit_thresholds_.find(unit_id);
+    if (it == unit_thresholds_.end())
+      return threshold_;
+    return it->second;
+  }
+
+  std::unordered_map<std::string, size_t> const&
+  ObjectCompressor::get_unit_thresholds() const {
+    return unit_thresholds_;
+  }
+
+  bool ObjectCompressor::compress(std::string& data_str,
+      std::string const& unit_id) {
+    if (data_str.size() < get_unit_threshold(unit_id))
+      return false;
+
+    auto begin = std::chrono::steady_clock::now();
+
+    std::string compressed;
+    compressed.reserve(compressed_prefix_size + data_str.size());
+    compressed.append(compressed_header, sizeof(compressed_header));
+    uint64_t original_size = data_str.size();
+    compressed.append(reinterpret_cast<char const*>(&original_size),
+        sizeof(original_size));
+    lz_compress(data_str.data(), data_str.size(), compressed);
+
+    bool shrunk =
+      compressed.size() <= data_str.size() - data_str.size() / 8;
+    if (shrunk) {
+      n_compressed_++;
+      original_size_ += data_str.size();
+      compressed_size_ += compressed.size();
+      data_str.swap(compressed);
+    }
+    else
+      n_incompressible_++;
+
+    compression_time_ += std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - begin).count();
+    return shrunk;
+  }
+
+  bool ObjectCompressor::decompress(std::string& data_str) {
+    if (!is_compressed(data_str))
+      return false;
+
+    auto begin = std::chrono::steady_clock::now();
+
+    uint64_t original_size;
+    std::memcpy(&original_size, data_str.data() + sizeof(compressed_header),
+        sizeof(original_size));
+
+    // Each byte of the stream gives at most 255 bytes
+    if (original_size / 255 > data_str.size())
+      throw std::runtime_error("corrupt compressed object");
+
+    std::string original(original_size, '\0');
+    if (!lz_decompress(data_str.data() + compressed_prefix_size,
+          data_str.size() - compressed_prefix_size, &original[0],
+          original.size()))
+      throw std::runtime_error("corrupt compressed object");
+    data_str.swap(original);
+
+    n_decompressed_++;
+    decompression_time_ +=
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now() - begin).count();
+    return true;
+  }
+
+  bool ObjectCompressor::is_compressed(std::string const& data_str) {
+    return data_str.size() >= compressed_prefix_size &&
+      std::memcmp(data_str.data(), compressed_header,
+          sizeof(compressed_header)) == 0;
+  }
+
+  ObjectCompressor::Statistics ObjectCompressor::get_statistics() const {
+    Statistics statistics;
+    statistics.n_compressed = n_compressed_;
+    statistics.n_incompressible = n_incompressible_;
+    statistics.original_size = original_size_;
+    statistics.compressed_size = compressed_size_;
+    statistics.compression_time = compression_time_ * 1e-9;
+    statistics.n_decompressed = n_decompressed_;
+    statistics.decompression_time = decompression_time_ * 1e-9;
+    return statistics;
+  }
+};
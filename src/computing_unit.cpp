@@ -1,32 +1,113 @@
 #include "computing_unit.hpp"
 
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
 namespace TaskDistribution {
+  // Information about the units registered. A registry is never changed after
+  // being published.
+  struct UnitRegistry {
+    std::unordered_map<std::string, size_t> ids;
+    std::unordered_map<Key, size_t> keys;
+    std::vector<BaseComputingUnit const*> units;
+  };
+
+  // Current registry. Readers only load the pointer, while writers hold the
+  // mutex and publish a changed copy. Null means that nothing was registered.
+  static std::atomic<UnitRegistry const*> registry(nullptr);
+
+  static std::mutex& registry_mutex() {
+    static std::mutex mutex;
+    return mutex;
+  }
+
+  // Publishes the new registry. The old ones are never freed, as readers may
+  // still be using them, but they're few as they only change when a unit or a
+  // key is first seen.
+  static void publish_registry(UnitRegistry* new_registry) {
+    static std::vector<std::unique_ptr<UnitRegistry const>> old_registries;
+    old_registries.emplace_back(new_registry);
+    registry.store(new_registry, std::memory_order_release);
+  }
+
   BaseComputingUnit const* BaseComputingUnit::get_by_id(std::string const& id) {
-    auto it = id_map_.find(id);
-    if (it == id_map_.end())
+    UnitRegistry const* current = registry.load(std::memory_order_acquire);
+    if (current == nullptr)
       return nullptr;
 
-    return it->second;
+    auto it = current->ids.find(id);
+    if (it == current->ids.end())
+      return nullptr;
+
+    return current->units[it->second];
   }
 
   BaseComputingUnit const* BaseComputingUnit::get_by_key(Key const& key) {
-    auto it = key_map_.find(key);
-    if (it == key_map_.end())
+    UnitRegistry const* current = registry.load(std::memory_order_acquire);
+    if (current == nullptr)
+      return nullptr;
+
+    auto it = current->keys.find(key);
+    if (it == current->keys.end())
+      return nullptr;
+
+    return current->units[it->second];
+  }
+
+  BaseComputingUnit const* BaseComputingUnit::get_by_index(size_t index) {
+    UnitRegistry const* current = registry.load(std::memory_order_acquire);
+    if (current == nullptr || index >= current->units.size())
       return nullptr;
 
-    return it->second;
+    return current->units[index];
   }
 
   bool BaseComputingUnit::bind_key(std::string const& id, Key const& key) {
+    std::lock_guard<std::mutex> lock(registry_mutex());
+
     BaseComputingUnit const* unit = get_by_id(id);
     if (unit == nullptr)
       return false;
-    key_map_.emplace(key, unit);
+
+    UnitRegistry const* current = registry.load(std::memory_order_acquire);
+    if (current->keys.count(key) != 0)
+      return true;
+
+    UnitRegistry* new_registry = new UnitRegistry(*current);
+    new_registry->keys.emplace(key, unit->index_);
+    publish_registry(new_registry);
     return true;
   }
 
-  std::unordered_map<std::string,BaseComputingUnit const*>
-    BaseComputingUnit::id_map_;
-  std::unordered_map<Key,BaseComputingUnit const*>
-    BaseComputingUnit::key_map_;
+  BaseComputingUnit const* BaseComputingUnit::register_unit(
+      std::string const& id,
+      std::function<BaseComputingUnit*()> const& create) {
+    // Most units are already registered, so tries first without locking
+    BaseComputingUnit const* unit = get_by_id(id);
+    if (unit != nullptr)
+      return unit;
+
+    std::lock_guard<std::mutex> lock(registry_mutex());
+
+    unit = get_by_id(id);
+    if (unit != nullptr)
+      return unit;
+
+    UnitRegistry const* current = registry.load(std::memory_order_acquire);
+    UnitRegistry* new_registry = current == nullptr ? new UnitRegistry() :
+      new UnitRegistry(*current);
+
+    BaseComputingUnit* new_unit = create();
+    new_unit->id_ = new std::string(id);
+    new_unit->index_ = new_registry->units.size();
+
+    new_registry->ids.emplace(id, new_unit->index_);
+    new_registry->units.push_back(new_unit);
+    publish_registry(new_registry);
+
+    return new_unit;
+  }
 };
@@ -5,32 +5,105 @@
 namespace TaskDistribution {
   ComputingUnitManager::ComputingUnitManager(
       ObjectArchive<Key>& archive):
-    archive_(archive) { }
+    archive_(archive),
+    writer_(archive, archive_mutex_),
+    asynchronous_writes_(true) { }
 
-  void ComputingUnitManager::process_local(TaskEntry& task) {
-    if (task.result_key.is_valid())
-      return;
+  ComputingUnitManager::~ComputingUnitManager() { }
 
-    task.result_key = new_key(Key::Result);
+  void ComputingUnitManager::process_local(TaskEntry& task,
+      BaseComputingUnit const* unit) {
+    if (task.has_result())
+      return;
 
     // Assumes that the computing unit is defined. TODO: remove this assumption.
-    BaseComputingUnit const* unit;
-
-    // Gets the correct computing unit and executes it
-    unit = BaseComputingUnit::get_by_key(task.computing_unit_id_key);
     if (unit == nullptr) {
-      std::string computing_unit_id;
-      archive_.load(task.computing_unit_id_key, computing_unit_id);
-      // Assumes true is always returned.
-      BaseComputingUnit::bind_key(computing_unit_id,
-          task.computing_unit_id_key);
+      std::lock_guard<std::recursive_mutex> lock(archive_mutex_);
+
+      // Gets the correct computing unit
       unit = BaseComputingUnit::get_by_key(task.computing_unit_id_key);
+      if (unit == nullptr) {
+        std::string computing_unit_id;
+        load_object(archive_, task.computing_unit_id_key, computing_unit_id,
+            compressor_);
+        // Assumes true is always returned.
+        BaseComputingUnit::bind_key(computing_unit_id,
+            task.computing_unit_id_key);
+        unit = BaseComputingUnit::get_by_key(task.computing_unit_id_key);
+      }
     }
 
-    // Processes the task using the correct unit
-    unit->execute(archive_, task, *this);
+    // Processes the task using the correct unit. The archive is locked only
+    // while data is loaded or stored, so that the computation itself may run
+    // concurrently with other tasks.
+    TaskCost cost;
+    unit->execute(archive_, task, *this, cost);
+
+    // A result given to the writer is followed by the entry, so that the
+    // archive never has an entry whose result is missing
+    if (asynchronous_writes_ && task.result_key.is_valid())
+      writer_.insert(task.task_key, std::make_shared<TaskEntry const>(task));
+
+    std::lock_guard<std::recursive_mutex> lock(archive_mutex_);
+    if (!asynchronous_writes_ || !task.result_key.is_valid())
+      archive_.insert(task.task_key, task);
+    cost_model_.add(unit->get_id(), cost.wall_time, cost.cpu_time);
+  }
+
+  void ComputingUnitManager::load_entry(Key const& task_key,
+      TaskEntry& entry) {
+    std::lock_guard<std::recursive_mutex> lock(archive_mutex_);
+
+    if (!writer_.get(task_key, entry))
+      archive_.load(task_key, entry);
+  }
+
+  std::recursive_mutex& ComputingUnitManager::get_archive_mutex() {
+    return archive_mutex_;
+  }
+
+  CostModel& ComputingUnitManager::get_cost_model() {
+    return cost_model_;
+  }
+
+  CostModel const& ComputingUnitManager::get_cost_model() const {
+    return cost_model_;
+  }
+
+  ResultCache& ComputingUnitManager::get_result_cache() {
+    return result_cache_;
+  }
+
+  ResultCache const& ComputingUnitManager::get_result_cache() const {
+    return result_cache_;
+  }
+
+  ObjectCompressor& ComputingUnitManager::get_compressor() {
+    return compressor_;
+  }
+
+  ObjectCompressor const& ComputingUnitManager::get_compressor() const {
+    return compressor_;
+  }
+
+  void ComputingUnitManager::clear_units() {
+    std::lock_guard<std::recursive_mutex> lock(archive_mutex_);
+    units_.clear();
+  }
+
+  void ComputingUnitManager::set_asynchronous_writes(
+      bool asynchronous_writes) {
+    if (!asynchronous_writes)
+      flush_results();
+    asynchronous_writes_ = asynchronous_writes;
+  }
+
+  bool ComputingUnitManager::get_asynchronous_writes() const {
+    return asynchronous_writes_;
+  }
 
-    archive_.insert(task.task_key, task);
+  void ComputingUnitManager::flush_results() {
+    writer_.flush();
   }
 
   Key ComputingUnitManager::new_key(Key::Type type) {
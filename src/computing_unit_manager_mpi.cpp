@@ -15,6 +15,10 @@ namespace TaskDistribution {
     world_(world),
     handler_(handler),
     tags_(tags) {
+      // MPI may not be called by other threads, so results are written
+      // directly
+      set_asynchronous_writes(false);
+
       // Set-up handlers
       handler.insert(tags_.task_begin,
           std::bind(&MPIComputingUnitManager::process_task_begin, this,
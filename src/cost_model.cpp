@@ -0,0 +1,114 @@
+#include "cost_model.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+
+namespace TaskDistribution {
+  static size_t const n_buckets = 128;
+  static double const buckets_per_decade = 8;
+  static double const first_bucket_time = 1e-6;
+
+  // CPU time used by the calling thread, or a negative value if it can't be
+  // measured.
+  static double thread_cpu_time() {
+    struct timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0)
+      return -1;
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+  }
+
+  CostTimer::CostTimer():
+    wall_begin_(std::chrono::steady_clock::now()),
+    cpu_begin_(thread_cpu_time()) { }
+
+  TaskCost CostTimer::elapsed() const {
+    TaskCost cost;
+    cost.wall_time = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - wall_begin_).count();
+    cost.cpu_time = thread_cpu_time();
+    cost.cpu_time = (cpu_begin_ < 0 || cost.cpu_time < 0) ? -1 :
+      cost.cpu_time - cpu_begin_;
+    return cost;
+  }
+
+  UnitCost::UnitCost():
+    n_tasks(0),
+    mean_wall_time(0),
+    m2_wall_time(0),
+    n_cpu_tasks(0),
+    mean_cpu_time(0),
+    histogram(n_buckets, 0) { }
+
+  void UnitCost::add(double wall_time, double cpu_time) {
+    // Welford's update of mean and variance
+    n_tasks++;
+    double delta = wall_time - mean_wall_time;
+    mean_wall_time += delta / n_tasks;
+    m2_wall_time += delta * (wall_time - mean_wall_time);
+
+    if (cpu_time >= 0) {
+      n_cpu_tasks++;
+      mean_cpu_time += (cpu_time - mean_cpu_time) / n_cpu_tasks;
+    }
+
+    size_t bucket = 0;
+    if (wall_time > first_bucket_time) {
+      double position =
+        std::log10(wall_time / first_bucket_time) * buckets_per_decade;
+      bucket = std::min<size_t>(position, n_buckets - 1);
+    }
+    histogram.resize(n_buckets, 0);
+    histogram[bucket]++;
+  }
+
+  double UnitCost::variance_wall_time() const {
+    if (n_tasks < 2)
+      return 0;
+    return m2_wall_time / (n_tasks - 1);
+  }
+
+  double UnitCost::percentile_wall_time(double fraction) const {
+    size_t target = std::ceil(fraction * n_tasks);
+    size_t accumulated = 0;
+
+    for (size_t i = 0; i < histogram.size(); i++) {
+      accumulated += histogram[i];
+      if (accumulated >= target && accumulated > 0)
+        // Upper limit of the bucket
+        return first_bucket_time * std::pow(10, (i + 1) / buckets_per_decade);
+    }
+
+    return 0;
+  }
+
+  void CostModel::add(std::string const& unit_id, double wall_time,
+      double cpu_time) {
+    units_[unit_id].add(wall_time, cpu_time);
+  }
+
+  UnitCost const* CostModel::get(std::string const& unit_id) const {
+    auto it = units_.find(unit_id);
+    if (it == units_.end())
+      return nullptr;
+
+    return &it->second;
+  }
+
+  double CostModel::get_mean_wall_time(std::string const& unit_id,
+      double default_value) const {
+    UnitCost const* cost = get(unit_id);
+    if (cost == nullptr || cost->n_tasks == 0)
+      return default_value;
+
+    return cost->mean_wall_time;
+  }
+
+  std::map<std::string, UnitCost> const& CostModel::get_units() const {
+    return units_;
+  }
+
+  void CostModel::clear() {
+    units_.clear();
+  }
+};
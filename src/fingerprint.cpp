@@ -0,0 +1,109 @@
+#include "fingerprint.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace TaskDistribution {
+  static uint64_t const c1 = 0x87c37b91114253d5ULL;
+  static uint64_t const c2 = 0x4cf5ad432745937fULL;
+
+  static inline uint64_t rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+  }
+
+  static inline uint64_t fmix64(uint64_t k) {
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+    return k;
+  }
+
+  Fingerprint Fingerprint::of(void const* data, size_t size) {
+    FingerprintHasher hasher;
+    hasher.update(data, size);
+    return hasher.finish();
+  }
+
+  Fingerprint Fingerprint::of(std::string const& data) {
+    return of(data.data(), data.size());
+  }
+
+  FingerprintHasher::FingerprintHasher():
+    h1_(0),
+    h2_(0),
+    length_(0),
+    buffer_size_(0) { }
+
+  void FingerprintHasher::update(void const* data, size_t size) {
+    unsigned char const* bytes = static_cast<unsigned char const*>(data);
+    length_ += size;
+
+    // Completes the block started by previous calls
+    if (buffer_size_ != 0) {
+      size_t n = std::min(size, 16 - buffer_size_);
+      memcpy(buffer_ + buffer_size_, bytes, n);
+      buffer_size_ += n;
+      bytes += n;
+      size -= n;
+
+      if (buffer_size_ < 16)
+        return;
+
+      process_block(buffer_);
+      buffer_size_ = 0;
+    }
+
+    for (; size >= 16; bytes += 16, size -= 16)
+      process_block(bytes);
+
+    memcpy(buffer_, bytes, size);
+    buffer_size_ = size;
+  }
+
+  void FingerprintHasher::process_block(unsigned char const* block) {
+    uint64_t k1, k2;
+    memcpy(&k1, block, 8);
+    memcpy(&k2, block + 8, 8);
+
+    k1 *= c1; k1 = rotl64(k1, 31); k1 *= c2; h1_ ^= k1;
+    h1_ = rotl64(h1_, 27); h1_ += h2_; h1_ = h1_*5 + 0x52dce729;
+
+    k2 *= c2; k2 = rotl64(k2, 33); k2 *= c1; h2_ ^= k2;
+    h2_ = rotl64(h2_, 31); h2_ += h1_; h2_ = h2_*5 + 0x38495ab5;
+  }
+
+  Fingerprint FingerprintHasher::finish() const {
+    uint64_t h1 = h1_, h2 = h2_;
+    uint64_t k1 = 0, k2 = 0;
+
+    // Tail with less than 16 bytes
+    for (size_t i = buffer_size_; i > 8; i--)
+      k2 ^= uint64_t(buffer_[i-1]) << ((i - 9) * 8);
+    if (buffer_size_ > 8) {
+      k2 *= c2; k2 = rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+    }
+
+    for (size_t i = std::min<size_t>(buffer_size_, 8); i > 0; i--)
+      k1 ^= uint64_t(buffer_[i-1]) << ((i - 1) * 8);
+    if (buffer_size_ > 0) {
+      k1 *= c1; k1 = rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+    }
+
+    // Finalization
+    h1 ^= length_;
+    h2 ^= length_;
+
+    h1 += h2;
+    h2 += h1;
+
+    h1 = fmix64(h1);
+    h2 = fmix64(h2);
+
+    h1 += h2;
+    h2 += h1;
+
+    return Fingerprint(h1, h2);
+  }
+};
@@ -0,0 +1,53 @@
+#include "flat_key_set.hpp"
+
+#include <algorithm>
+
+namespace TaskDistribution {
+  FlatKeySet::FlatKeySet(std::initializer_list<Key> keys) {
+    insert(keys.begin(), keys.end());
+  }
+
+  std::pair<FlatKeySet::iterator, bool> FlatKeySet::insert(Key const& key) {
+    // Fast path for keys created after every other
+    if (keys_.empty() || keys_.back() < key) {
+      keys_.push_back(key);
+      return std::make_pair(keys_.end() - 1, true);
+    }
+
+    auto it = std::lower_bound(keys_.begin(), keys_.end(), key);
+    if (*it == key)
+      return std::make_pair(iterator(it), false);
+
+    return std::make_pair(iterator(keys_.insert(it, key)), true);
+  }
+
+  FlatKeySet::size_type FlatKeySet::erase(Key const& key) {
+    auto it = std::lower_bound(keys_.begin(), keys_.end(), key);
+    if (it == keys_.end() || !(*it == key))
+      return 0;
+
+    keys_.erase(it);
+    return 1;
+  }
+
+  FlatKeySet::iterator FlatKeySet::find(Key const& key) const {
+    auto it = std::lower_bound(keys_.begin(), keys_.end(), key);
+    if (it == keys_.end() || !(*it == key))
+      return keys_.end();
+    return it;
+  }
+
+  FlatKeySet::size_type FlatKeySet::count(Key const& key) const {
+    return find(key) == keys_.end() ? 0 : 1;
+  }
+
+  void FlatKeySet::merge_from(size_type first) {
+    auto middle = keys_.begin() + first;
+    if (!std::is_sorted(middle, keys_.end()))
+      std::sort(middle, keys_.end());
+    if (first != 0 && middle != keys_.end() && *middle < *(middle - 1))
+      std::inplace_merge(keys_.begin(), middle, keys_.end());
+
+    keys_.erase(std::unique(keys_.begin(), keys_.end()), keys_.end());
+  }
+};
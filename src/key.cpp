@@ -2,5 +2,35 @@
 
 namespace TaskDistribution {
   // Objects start at id == 1
-  size_t Key::next_obj = 1;
+  std::atomic<size_t> Key::next_obj(1);
+
+  // Smallest id that new objects may have. Leased ranges starting below it
+  // are dropped.
+  static std::atomic<size_t> min_obj(1);
+
+  // Range [next, end) of object ids leased to the thread.
+  struct ObjLease {
+    size_t next, end;
+  };
+  static thread_local ObjLease lease = {0, 0};
+
+  void Key::update_next_obj(size_t obj) {
+    size_t current = next_obj.load();
+    while (current < obj && !next_obj.compare_exchange_weak(current, obj)) { }
+
+    // Even if the counter is already past obj, leased ranges may be below it,
+    // but the ones above it are still valid
+    current = min_obj.load();
+    while (current < obj && !min_obj.compare_exchange_weak(current, obj)) { }
+  }
+
+  size_t Key::new_obj() {
+    if (lease.next == lease.end ||
+        lease.next < min_obj.load(std::memory_order_acquire)) {
+      lease.next = next_obj.fetch_add(obj_lease_size);
+      lease.end = lease.next + obj_lease_size;
+    }
+
+    return lease.next++;
+  }
 };
@@ -0,0 +1,96 @@
+#include "ready_queue.hpp"
+
+#include <algorithm>
+
+namespace TaskDistribution {
+  size_t const ReadyQueue::no_index;
+
+  ReadyQueue::ReadyQueue():
+    prioritized_(false),
+    next_order_(0) { }
+
+  bool ReadyQueue::push(Key const& task_key, double priority,
+      size_t index) {
+    if (!keys_.insert(task_key).second)
+      return false;
+
+    Item item({task_key, priority, next_order_++, index});
+
+    if (prioritized_) {
+      heap_.push_back(item);
+      std::push_heap(heap_.begin(), heap_.end());
+    }
+    else
+      queue_.push_back(item);
+
+    return true;
+  }
+
+  Key ReadyQueue::pop() {
+    size_t index;
+    return pop(index);
+  }
+
+  Key ReadyQueue::pop(size_t& index) {
+    Item item;
+
+    if (prioritized_) {
+      std::pop_heap(heap_.begin(), heap_.end());
+      item = heap_.back();
+      heap_.pop_back();
+    }
+    else {
+      item = queue_.front();
+      queue_.pop_front();
+    }
+
+    keys_.erase(item.task_key);
+    index = item.index;
+    return item.task_key;
+  }
+
+  bool ReadyQueue::contains(Key const& task_key) const {
+    return keys_.find(task_key) != keys_.end();
+  }
+
+  bool ReadyQueue::empty() const {
+    return keys_.empty();
+  }
+
+  size_t ReadyQueue::size() const {
+    return keys_.size();
+  }
+
+  void ReadyQueue::set_prioritized(bool prioritized) {
+    if (prioritized == prioritized_)
+      return;
+
+    prioritized_ = prioritized;
+
+    if (prioritized_) {
+      heap_.assign(queue_.begin(), queue_.end());
+      queue_.clear();
+      std::make_heap(heap_.begin(), heap_.end());
+    }
+    else {
+      // Keeps the order in which tasks were added
+      std::sort(heap_.begin(), heap_.end(),
+          [](Item const& i1, Item const& i2) { return i1.order < i2.order; });
+      queue_.assign(heap_.begin(), heap_.end());
+      heap_.clear();
+    }
+  }
+
+  bool ReadyQueue::is_prioritized() const {
+    return prioritized_;
+  }
+
+  void ReadyQueue::update_priorities(priority_function_type const& priority) {
+    for (auto& item : queue_)
+      item.priority = priority(item.task_key);
+
+    for (auto& item : heap_)
+      item.priority = priority(item.task_key);
+    std::make_heap(heap_.begin(), heap_.end());
+  }
+};
@@ -0,0 +1,107 @@
+#include "result_cache.hpp"
+
+namespace TaskDistribution {
+  ResultCache::ResultCache(size_t capacity):
+    capacity_(capacity),
+    size_(0),
+    hits_(0),
+    misses_(0),
+    evictions_(0) { }
+
+  void ResultCache::remove(Key const& key) {
+    auto it = entries_.find(key);
+    if (it == entries_.end())
+      return;
+
+    size_ -= it->second.size;
+    order_.erase(it->second.position);
+    entries_.erase(it);
+  }
+
+  void ResultCache::resize(Key const& key, void const* object, size_t size) {
+    auto it = entries_.find(key);
+    if (it == entries_.end() || it->second.object.get() != object)
+      return;
+
+    if (size > capacity_) {
+      remove(key);
+      return;
+    }
+
+    size_ = size_ - it->second.size + size;
+    it->second.size = size;
+
+    // The entry resized is kept, as it was just used
+    order_.splice(order_.begin(), order_, it->second.position);
+    evict(capacity_);
+  }
+
+  void ResultCache::clear() {
+    entries_.clear();
+    order_.clear();
+    size_ = 0;
+  }
+
+  void ResultCache::set_capacity(size_t capacity) {
+    capacity_ = capacity;
+    evict(capacity_);
+  }
+
+  size_t ResultCache::get_capacity() const {
+    return capacity_;
+  }
+
+  size_t ResultCache::get_size() const {
+    return size_;
+  }
+
+  size_t ResultCache::get_number_of_results() const {
+    return entries_.size();
+  }
+
+  size_t ResultCache::get_hits() const {
+    return hits_;
+  }
+
+  size_t ResultCache::get_misses() const {
+    return misses_;
+  }
+
+  size_t ResultCache::get_evictions() const {
+    return evictions_;
+  }
+
+  ResultCache::Entry* ResultCache::find(Key const& key,
+      std::type_index const& type) {
+    auto it = entries_.find(key);
+    if (it == entries_.end() || it->second.type != type) {
+      misses_++;
+      return nullptr;
+    }
+
+    hits_++;
+    order_.splice(order_.begin(), order_, it->second.position);
+    return &it->second;
+  }
+
+  void ResultCache::insert_entry(Key const& key,
+      std::shared_ptr<void const> const& object, std::type_index const& type,
+      size_t size) {
+    remove(key);
+    evict(capacity_ - size);
+
+    order_.push_front(key);
+    entries_.emplace(key, Entry({object, type, size, order_.begin()}));
+    size_ += size;
+  }
+
+  void ResultCache::evict(size_t max_size) {
+    while (size_ > max_size) {
+      auto it = entries_.find(order_.back());
+      size_ -= it->second.size;
+      entries_.erase(it);
+      order_.pop_back();
+      evictions_++;
+    }
+  }
+};
@@ -9,7 +9,8 @@ namespace TaskDistribution {
     task_manager_(task_manager),
     cmd_args_(""),
     help_args_(""),
-    invalidate_args_("") {
+    invalidate_args_(""),
+    run_args_("") {
       // Create command line arguments
       cmd_args_.add_options()
         ("command", po::value<std::string>(), "")
@@ -23,11 +24,16 @@ namespace TaskDistribution {
         ("invalid,i", po::value<std::string>(), "kind of task to invalidate")
         ;
 
+      run_args_.add_options()
+        ("threads,j", po::value<size_t>(), "number of threads used locally")
+        ("critical-path", "run first the tasks in longer dependency chains")
+        ;
+
       po::positional_options_description p;
       p.add("command", 1);
 
       po::options_description all("Allowed options");
-      all.add(cmd_args_).add(help_args_).add(invalidate_args_);
+      all.add(cmd_args_).add(help_args_).add(invalidate_args_).add(run_args_);
 
       po::store(po::command_line_parser(argc, argv).
           options(all).positional(p).run(), vm_);
@@ -91,7 +97,7 @@ namespace TaskDistribution {
       if (cmd == "run") {
         if (vm_.count("help")) {
           po::options_description allowed("Allowed options");
-          allowed.add(help_args_);
+          allowed.add(help_args_).add(run_args_);
           std::cout << allowed << std::endl;
           return 1;
         }
@@ -129,7 +135,7 @@ namespace TaskDistribution {
       for (auto& task_key : unit_entry.second.keys) {
         TaskEntry task_entry;
         archive_.load(task_key, task_entry);
-        if (task_entry.result_key.is_valid())
+        if (task_entry.has_result())
           unit_entry.second.finished++;
         else
           unit_entry.second.waiting++;
@@ -187,14 +193,44 @@ namespace TaskDistribution {
       std::cout << padding_str << running_str;
       std::cout << std::endl;
     }
+
+    // Estimates the remaining time with the mean time of each unit's tasks
+    CostModel const& cost_model = task_manager_.get_cost_model();
+    double remaining_time = 0;
+    for (auto& it : map_units_to_tasks_)
+      remaining_time += (it.second.waiting + it.second.running) *
+        cost_model.get_mean_wall_time(it.first, 0);
+
+    if (remaining_time > 0)
+      printf("Estimated time remaining: %.1f s\n",
+          remaining_time / task_manager_.get_number_of_workers());
+
     std::cout << std::endl;
   }
 
+  void Runnable::print_compression_summary(
+      ObjectCompressor::Statistics const& statistics) {
+    if (statistics.n_compressed + statistics.n_incompressible > 0) {
+      double ratio = statistics.compressed_size == 0 ? 1 :
+        double(statistics.original_size) / statistics.compressed_size;
+      printf("Compressed %zu objects from %.1f MB to %.1f MB (%.2fx) in "
+          "%.3f s, %zu left uncompressed\n", statistics.n_compressed,
+          statistics.original_size / (1024.*1024),
+          statistics.compressed_size / (1024.*1024), ratio,
+          statistics.compression_time, statistics.n_incompressible);
+    }
+
+    if (statistics.n_decompressed > 0)
+      printf("Decompressed %zu objects in %.3f s\n",
+          statistics.n_decompressed, statistics.decompression_time);
+  }
+
   void Runnable::check() {
     if (task_manager_.id() != 0)
       return;
 
     create_tasks();
+    task_manager_.save_archive_index();
     create_unit_map();
     print_status();
   }
@@ -219,19 +255,33 @@ namespace TaskDistribution {
       return;
 
     create_tasks();
+    task_manager_.save_archive_index();
     invalidate_unit(unit_name);
     create_unit_map();
     print_status();
   }
 
   void Runnable::run() {
+    if (vm_.count("threads"))
+      task_manager_.set_number_of_threads(vm_["threads"].as<size_t>());
+
+    if (vm_.count("critical-path"))
+      task_manager_.set_scheduling(TaskManager::CriticalPath);
+
     create_tasks();
+    task_manager_.save_archive_index();
     create_unit_map();
 
     task_manager_.run();
 
-    if (task_manager_.id() == 0)
+    // Every process gives its statistics to the master
+    ObjectCompressor::Statistics statistics =
+      task_manager_.get_compression_statistics();
+
+    if (task_manager_.id() == 0) {
+      print_compression_summary(statistics);
       process_results();
+    }
   }
 
   void Runnable::task_creation_handler(std::string const& name,
@@ -266,6 +316,9 @@ namespace TaskDistribution {
   }
 
   void Runnable::clean_tasks() {
+    // Children lists must be complete to remove every descendant
+    task_manager_.flush_family_lists();
+
     // Gets the tasks associated with all computing units
     KeySet created_tasks;
     for (auto& it : map_units_to_tasks_)
@@ -274,7 +327,7 @@ namespace TaskDistribution {
     // Gets all tasks in archive
     KeySet available_keys;
     for (auto& it : archive_.available_objects())
-      if (it->type == Key::Task)
+      if (it->get_type() == Key::Task)
         available_keys.insert(*it);
 
     size_t tasks_removed = 0;
@@ -319,6 +372,12 @@ namespace TaskDistribution {
 
     // Fills the empty places of old keys
     relocate_keys();
+
+    // Tasks entries may have changed with the relocation, so their
+    // fingerprints must be computed again by the next run. Objects kept in
+    // memory may have new keys also.
+    task_manager_.remove_archive_index();
+    task_manager_.clear_caches();
   }
 
   void Runnable::invalidate_unit(std::string const& unit_name) {
@@ -339,17 +398,16 @@ namespace TaskDistribution {
     archive_.load(task_key, entry);
 
     // If result is invalid, children must also have invalid result
-    if (entry.result_key.is_valid()) {
-      archive_.remove(entry.result_key);
-      entry.result_key = Key();
+    if (entry.has_result()) {
+      if (entry.result_key.is_valid())
+        archive_.remove(entry.result_key);
+      entry.clear_result();
       archive_.insert(task_key, entry);
 
-      if (entry.children_key.is_valid()) {
-        KeySet children;
-        archive_.load(entry.children_key, children);
-        for (auto& child_key : children)
-          remove_result(child_key);
-      }
+      FlatKeySet children;
+      task_manager_.load_children(entry, children);
+      for (auto& child_key : children)
+        remove_result(child_key);
     }
   }
 
@@ -381,13 +439,13 @@ namespace TaskDistribution {
     if (entry.parents_key.is_valid())
       archive_.remove(entry.parents_key);
 
-    if (entry.children_key.is_valid()) {
-      KeySet children;
-      archive_.load(entry.children_key, children);
-      for (auto& child_key : children)
-        tasks_removed += remove_task(child_key, possible_removals);
+    FlatKeySet children;
+    task_manager_.load_children(entry, children);
+    for (auto& child_key : children)
+      tasks_removed += remove_task(child_key, possible_removals);
+
+    if (entry.children_key.is_valid())
       archive_.remove(entry.children_key);
-    }
 
     archive_.remove(task_key);
 
@@ -411,7 +469,7 @@ namespace TaskDistribution {
     std::map<Key, KeySet> map_key_to_task_key;
     KeySet used_keys;
     for (auto& it : archive_.available_objects()) {
-      if (it->type == Key::Task) {
+      if (it->get_type() == Key::Task) {
         Key const& task_key = *it;
         used_keys.insert(task_key);
 
@@ -441,19 +499,19 @@ namespace TaskDistribution {
     auto used_keys_end = used_keys.end();
     while (used_keys_it != used_keys_end) {
       // Checks if changed node id
-      if (used_keys_it->node_id != current_node_id) {
-        current_node_id = used_keys_it->node_id;
+      if (used_keys_it->get_node_id() != current_node_id) {
+        current_node_id = used_keys_it->get_node_id();
         last_obj_id = 0;
       }
 
       // Tasks can't be moved
-      if (used_keys_it->type == Key::Task) {
+      if (used_keys_it->get_type() == Key::Task) {
         ++used_keys_it;
         continue;
       }
 
       // If there's a gap
-      if (used_keys_it->obj_id - last_obj_id > 1) {
+      if (used_keys_it->get_obj_id() - last_obj_id > 1) {
         // If the key is already in use, continue
         if (used_keys.find(Key({current_node_id, last_obj_id+1, Key::Task})) !=
             used_keys.end()) {
@@ -463,7 +521,7 @@ namespace TaskDistribution {
 
         // Moves the data from the old key to the new key
         Key const& current_key = *used_keys_it;
-        Key new_key({current_node_id, last_obj_id+1, current_key.type});
+        Key new_key({current_node_id, last_obj_id+1, current_key.get_type()});
         archive_.change_key(current_key, new_key);
 
         // Replaces the key in evey task entry used by it
@@ -0,0 +1,148 @@
+#include "task_graph.hpp"
+
+#include <algorithm>
+
+namespace TaskDistribution {
+  size_t const TaskGraph::no_unit;
+
+  TaskGraph::Index TaskGraph::insert(Key const& task_key) {
+    auto it = map_key_to_index_.find(task_key);
+    if (it != map_key_to_index_.end())
+      return it->second;
+
+    Index index = keys_.size();
+    map_key_to_index_.emplace(task_key, index);
+    keys_.push_back(task_key);
+    active_parents_.emplace_back(0);
+    units_.push_back(no_unit);
+    costs_.push_back(1);
+    return index;
+  }
+
+  bool TaskGraph::find(Key const& task_key, Index& index) const {
+    auto it = map_key_to_index_.find(task_key);
+    if (it == map_key_to_index_.end())
+      return false;
+
+    index = it->second;
+    return true;
+  }
+
+  Key const& TaskGraph::get_key(Index index) const {
+    return keys_[index];
+  }
+
+  size_t TaskGraph::size() const {
+    return keys_.size();
+  }
+
+  void TaskGraph::add_edge(Index parent, Index child) {
+    new_edges_.emplace_back(parent, child);
+  }
+
+  void TaskGraph::set_active_parents(Index index, size_t active_parents) {
+    active_parents_[index] = active_parents;
+  }
+
+  bool TaskGraph::parent_finished(Index index) {
+    // Never goes below zero, as a parent may be reported after the child was
+    // created knowing that the parent had already finished.
+    std::atomic<size_t>& counter = active_parents_[index];
+    size_t current = counter.load();
+    while (current != 0 &&
+        !counter.compare_exchange_weak(current, current - 1)) { }
+
+    return current == 1;
+  }
+
+  TaskGraph::Range TaskGraph::get_children(Index index) {
+    if (!new_edges_.empty() || children_offset_.size() != keys_.size() + 1)
+      compact();
+
+    Index const* data = children_.data();
+    return Range({data + children_offset_[index],
+        data + children_offset_[index + 1]});
+  }
+
+  void TaskGraph::set_unit(Index index, size_t unit_index) {
+    units_[index] = unit_index;
+  }
+
+  size_t TaskGraph::get_unit(Index index) const {
+    return units_[index];
+  }
+
+  void TaskGraph::set_cost(Index index, double cost) {
+    costs_[index] = cost;
+  }
+
+  void TaskGraph::compute_bottom_levels() {
+    if (!new_edges_.empty() || children_offset_.size() != keys_.size() + 1)
+      compact();
+
+    // Finds a topological order by removing tasks without parents
+    std::vector<size_t> n_parents(keys_.size(), 0);
+    for (auto child : children_)
+      n_parents[child]++;
+
+    std::vector<Index> order;
+    order.reserve(keys_.size());
+    for (Index i = 0; i < keys_.size(); i++)
+      if (n_parents[i] == 0)
+        order.push_back(i);
+
+    for (size_t i = 0; i < order.size(); i++)
+      for (auto child : get_children(order[i]))
+        if (--n_parents[child] == 0)
+          order.push_back(child);
+
+    // Children come after their parents, so the reverse order has every child
+    // computed before its parents
+    bottom_levels_.assign(keys_.size(), 0);
+    for (auto it = order.rbegin(); it != order.rend(); ++it) {
+      double max_child = 0;
+      for (auto child : get_children(*it))
+        max_child = std::max(max_child, bottom_levels_[child]);
+      bottom_levels_[*it] = costs_[*it] + max_child;
+    }
+  }
+
+  double TaskGraph::get_bottom_level(Index index) const {
+    if (index >= bottom_levels_.size())
+      return 0;
+    return bottom_levels_[index];
+  }
+
+  void TaskGraph::compact() {
+    // Current edges are already sorted, so only the new ones must be sorted
+    // before merging
+    std::vector<std::pair<Index, Index>> edges;
+    edges.reserve(children_.size() + new_edges_.size());
+
+    for (Index i = 0; i + 1 < children_offset_.size(); i++)
+      for (size_t j = children_offset_[i]; j < children_offset_[i+1]; j++)
+        edges.emplace_back(i, children_[j]);
+
+    size_t n_old_edges = edges.size();
+
+    std::sort(new_edges_.begin(), new_edges_.end());
+    edges.insert(edges.end(), new_edges_.begin(), new_edges_.end());
+    new_edges_.clear();
+
+    std::inplace_merge(edges.begin(), edges.begin() + n_old_edges,
+        edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+    // Builds the offsets by counting the children of each task
+    children_offset_.assign(keys_.size() + 1, 0);
+    for (auto& edge : edges)
+      children_offset_[edge.first + 1]++;
+
+    for (size_t i = 1; i < children_offset_.size(); i++)
+      children_offset_[i] += children_offset_[i-1];
+
+    children_.resize(edges.size());
+    for (size_t i = 0; i < edges.size(); i++)
+      children_[i] = edges[i].second;
+  }
+};
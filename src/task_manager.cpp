@@ -1,77 +1,334 @@
 #include "task_manager.hpp"
 
+#include "computing_unit.hpp"
+
+#include <boost/serialization/utility.hpp>
+#include <boost/serialization/vector.hpp>
+#include <thread>
+
 namespace TaskDistribution {
+  // Index of fingerprints stored in the archive. Fingerprints of task entries
+  // depend on the entry's format, so they are only used if the entries had the
+  // same version.
+  struct ArchiveIndex {
+    ArchiveIndex(): task_entry_version(0) { }
+
+    std::vector<std::pair<Key, Fingerprint>> objects;
+    std::vector<std::pair<Key, Fingerprint>> bytes;
+    unsigned int task_entry_version;
+
+    template<class Archive>
+    void serialize(Archive& ar, const unsigned int version) {
+      ar & objects;
+      ar & bytes;
+      if (version > 0)
+        ar & task_entry_version;
+    }
+  };
+  static unsigned int const current_task_entry_version =
+    boost::serialization::version<TaskEntry>::value;
+  static Key const archive_index_key = Key::metadata_key(1);
+  static Key const cost_model_key = Key::metadata_key(2);
+
+  // Marks archives whose objects were all stored with the fast codec available.
+  // Older archives may have objects serialized through boost instead.
+  static Key const fast_codec_marker_key = Key::metadata_key(3);
+
   TaskManager::TaskManager(ObjectArchive<Key>& archive,
       ComputingUnitManager& unit_manager):
     archive_(archive),
-    unit_manager_(unit_manager) { }
-
-  TaskManager::~TaskManager() { }
+    unit_manager_(unit_manager),
+    n_bytes_hashes_(0),
+    trust_fingerprints_(false),
+    legacy_encodings_(false),
+    archive_index_changed_(false),
+    n_tasks_created_(0),
+    scheduling_(FirstInFirstOut),
+    n_threads_(1) { }
+
+  TaskManager::~TaskManager() {
+    flush_family_lists();
+  }
 
   void TaskManager::run() {
-    run_single();
+    prepare_ready_queue();
+
+    run_tasks(ready_, task_begin_handler_,
+        [this](Key const& task_key) { task_completed(task_key); },
+        [this](Key const& task_key) { release_children(task_key); });
+
+    save_cost_model();
   }
 
-  void TaskManager::run_single() {
-    while (!ready_.empty()) {
-      Key task_key = ready_.front();
-      ready_.pop_front();
+  void TaskManager::run_tasks(ReadyQueue& queue,
+      action_handler_type const& begin_handler,
+      action_handler_type const& end_handler,
+      action_handler_type const& skip_handler) {
+    size_t n_running = 0;
+    std::condition_variable_any ready_condition;
+
+    if (n_threads_ > 1) {
+      std::vector<std::thread> threads;
+      for (size_t i = 0; i < n_threads_; i++)
+        threads.emplace_back(&TaskManager::run_tasks_worker, this,
+            std::ref(queue), std::cref(begin_handler), std::cref(end_handler),
+            std::cref(skip_handler), std::ref(n_running),
+            std::ref(ready_condition));
+
+      for (auto& thread : threads)
+        thread.join();
+    }
+    else
+      run_tasks_worker(queue, begin_handler, end_handler, skip_handler,
+          n_running, ready_condition);
+
+    unit_manager_.flush_results();
+  }
+
+  void TaskManager::run_tasks_worker(ReadyQueue& queue,
+      action_handler_type const& begin_handler,
+      action_handler_type const& end_handler,
+      action_handler_type const& skip_handler, size_t& n_running,
+      std::condition_variable_any& ready_condition) {
+    // The archive mutex also protects the manager's data, as the dependency
+    // analysis loads and stores entries anyway.
+    std::unique_lock<std::recursive_mutex> lock(
+        unit_manager_.get_archive_mutex());
+
+    while (1) {
+      // Waits for new tasks while other threads may still release some
+      while (queue.empty() && n_running != 0)
+        ready_condition.wait(lock);
+
+      if (queue.empty())
+        break;
+
+      size_t index;
+      Key task_key = queue.pop(index);
       TaskEntry entry;
-      archive_.load(task_key, entry);
-      task_begin_handler_(task_key);
-      unit_manager_.process_local(entry);
-      task_completed(task_key);
+      unit_manager_.load_entry(task_key, entry);
+
+      if (entry.has_result()) {
+        skip_handler(task_key);
+        ready_condition.notify_all();
+        continue;
+      }
+
+      // Tasks in the graph have their unit known, while the others have it
+      // found by key
+      BaseComputingUnit const* unit = nullptr;
+      if (index != ReadyQueue::no_index)
+        unit = BaseComputingUnit::get_by_index(graph_.get_unit(index));
+
+      begin_handler(task_key);
+      n_running++;
+
+      lock.unlock();
+      unit_manager_.process_local(entry, unit);
+      lock.lock();
+
+      n_running--;
+      end_handler(task_key);
+      ready_condition.notify_all();
     }
   }
 
   void TaskManager::task_completed(Key const& task_key) {
+    release_children(task_key);
+    task_end_handler_(task_key);
+  }
+
+  void TaskManager::release_children(Key const& task_key) {
+    TaskGraph::Index index;
+    if (graph_.find(task_key, index))
+      for (auto child_index : graph_.get_children(index))
+        if (graph_.parent_finished(child_index))
+          ready_.push(graph_.get_key(child_index),
+              graph_.get_bottom_level(child_index), child_index);
+  }
+
+  void TaskManager::compute_on_demand(Key const& task_key) {
+    // Finds the tasks without result required by the given one, counting for
+    // each the required parents without result. Tasks are found only once, so
+    // shared ancestors are computed only once.
+    std::unordered_map<Key, size_t> active_parents;
+    std::unordered_map<Key, KeyList> children;
     {
-      auto it = map_task_to_children_.find(task_key);
-      if (it != map_task_to_children_.end()) {
-        for (auto& child_key: it->second) {
-          TaskEntry child_entry;
-          archive_.load(child_key, child_entry);
-          child_entry.active_parents--;
-          if (child_entry.active_parents == 0)
-            ready_.push_back(child_key);
-          archive_.insert(child_key, child_entry);
+      std::lock_guard<std::recursive_mutex> lock(
+          unit_manager_.get_archive_mutex());
+
+      KeyList to_visit({task_key});
+      active_parents.emplace(task_key, 0);
+      while (!to_visit.empty()) {
+        Key key = to_visit.back();
+        to_visit.pop_back();
+
+        TaskEntry entry;
+        unit_manager_.load_entry(key, entry);
+
+        FlatKeySet parents;
+        load_parents(entry, parents);
+        for (auto& parent_key : parents) {
+          TaskEntry parent_entry;
+          unit_manager_.load_entry(parent_key, parent_entry);
+          if (parent_entry.has_result())
+            continue;
+
+          active_parents[key]++;
+          children[parent_key].push_back(key);
+          if (active_parents.emplace(parent_key, 0).second)
+            to_visit.push_back(parent_key);
         }
       }
     }
-    task_end_handler_(task_key);
+
+    // Results are stored as usual, so these tasks are skipped by the next
+    // run, which only releases their children
+    ReadyQueue queue;
+    for (auto& it : active_parents)
+      if (it.second == 0)
+        queue.push(it.first);
+
+    auto release = [&](Key const& key) {
+      for (auto& child_key : children[key])
+        if (--active_parents[child_key] == 0)
+          queue.push(child_key);
+    };
+    run_tasks(queue, [](Key const&){}, release, release);
+  }
+
+  void TaskManager::prepare_ready_queue() {
+    flush_family_lists();
+
+    if (scheduling_ == CriticalPath) {
+      graph_.compute_bottom_levels();
+      ready_.set_prioritized(true);
+      ready_.update_priorities(
+          [this](Key const& task_key) { return get_priority(task_key); });
+    }
+    else
+      ready_.set_prioritized(false);
+  }
+
+  double TaskManager::get_priority(Key const& task_key) const {
+    TaskGraph::Index index;
+    if (!graph_.find(task_key, index))
+      return 0;
+
+    return graph_.get_bottom_level(index);
   }
 
   size_t TaskManager::id() const {
     return 0;
   }
 
+  void TaskManager::set_number_of_threads(size_t n_threads) {
+    n_threads_ = std::max<size_t>(n_threads, 1);
+  }
+
+  size_t TaskManager::get_number_of_threads() const {
+    return n_threads_;
+  }
+
+  size_t TaskManager::get_number_of_workers() const {
+    return n_threads_;
+  }
+
+  CostModel const& TaskManager::get_cost_model() const {
+    return unit_manager_.get_cost_model();
+  }
+
+  ResultCache& TaskManager::get_result_cache() {
+    return unit_manager_.get_result_cache();
+  }
+
+  ObjectCompressor& TaskManager::get_compressor() {
+    return unit_manager_.get_compressor();
+  }
+
+  ObjectCompressor::Statistics TaskManager::get_compression_statistics() {
+    return get_compressor().get_statistics();
+  }
+
+  void TaskManager::clear_caches() {
+    unit_manager_.get_result_cache().clear();
+    unit_manager_.clear_units();
+  }
+
+  void TaskManager::save_cost_model() {
+    if (id() != 0)
+      return;
+
+    archive_.insert(cost_model_key, unit_manager_.get_cost_model());
+  }
+
+  TaskManager::FingerprintShard& TaskManager::get_shard(
+      FingerprintShards& shards, Fingerprint const& fingerprint) {
+    // The low bits are used by the maps' hash
+    return shards[fingerprint.high % n_fingerprint_shards];
+  }
+
+  void TaskManager::store_again(Key const& key, std::string data_str,
+      std::string const& unit_id) {
+    unit_manager_.get_compressor().compress(data_str, unit_id);
+
+    std::lock_guard<std::recursive_mutex> lock(
+        unit_manager_.get_archive_mutex());
+    archive_.insert_raw(key, std::move(data_str));
+    creation_operations_.n_inserts++;
+    creation_operations_.n_writes++;
+  }
+
   std::string TaskManager::load_string_to_hash(Key const& key) {
+    std::lock_guard<std::recursive_mutex> lock(
+        unit_manager_.get_archive_mutex());
+
+    creation_operations_.n_loads++;
+
     std::string data_str;
-    if (key.type != Key::Task) {
+    if (key.get_type() != Key::Task) {
       archive_.load_raw(key, data_str);
+      unit_manager_.get_compressor().decompress(data_str);
     }
     else {
       TaskEntry entry;
       archive_.load(key, entry);
-      // Special case of tasks different from the identity
-      if (entry.computing_unit_id_key.is_valid()) {
-        entry.result_key = Key();
-        entry.parents_key = Key();
-        entry.children_key = Key();
-        entry.active_parents = 0;
-      }
-      entry.task_key = Key();
-
+      clear_entry_state(entry);
       data_str = ObjectArchive<Key>::serialize(entry);
     }
 
     return data_str;
   }
 
+  Fingerprint TaskManager::get_fingerprint(TaskEntry const& data,
+      std::string& data_str) {
+    data_str = ObjectArchive<Key>::serialize(data);
+    return Fingerprint::of(data_str);
+  }
+
+  Fingerprint TaskManager::get_boost_fingerprint(std::string const& data,
+      std::string& data_str) {
+    data_str = ObjectArchive<Key>::serialize(data);
+    return Fingerprint::of(data_str);
+  }
+
+  void TaskManager::clear_entry_state(TaskEntry& entry) {
+    // Special case of tasks different from the identity
+    if (entry.computing_unit_id_key.is_valid()) {
+      entry.clear_result();
+      entry.active_parents = 0;
+    }
+    entry.task_key = Key();
+    entry.parents_key = Key();
+    entry.children_key = Key();
+    entry.parents.clear();
+    entry.children.clear();
+  }
+
   void TaskManager::update_used_keys(std::map<int, size_t> const& used_keys) {
     auto it = used_keys.find(id());
     if (it != used_keys.end())
-      Key::next_obj = std::max(Key::next_obj, it->second + 1);
+      Key::update_next_obj(it->second + 1);
   }
 
   void TaskManager::load_archive() {
@@ -81,27 +338,187 @@ namespace TaskDistribution {
     if (id() != 0)
       return;
 
-    std::hash<std::string> hasher;
+    legacy_encodings_ = !archive_.is_available(fast_codec_marker_key);
+
+    // Restores the fingerprints saved previously. In archives written before
+    // the fast codec, objects other than tasks may have been fingerprinted
+    // through boost, so they are known only by their bytes until found again.
+    std::unordered_map<Key, Fingerprint> index, bytes_index;
+    if (archive_.is_available(archive_index_key)) {
+      // An index that can't be read is just computed again
+      try {
+        ArchiveIndex saved_index;
+        archive_.load(archive_index_key, saved_index);
+        for (auto& it : saved_index.objects)
+          if (it.first.get_type() != Key::Task ? !legacy_encodings_ :
+              saved_index.task_entry_version == current_task_entry_version)
+            index.insert(it);
+        bytes_index.insert(saved_index.bytes.begin(),
+            saved_index.bytes.end());
+      }
+      catch (std::exception const&) {
+        index.clear();
+        bytes_index.clear();
+      }
+    }
+
+    // Restores the costs measured in previous runs
+    if (archive_.is_available(cost_model_key)) {
+      try {
+        archive_.load(cost_model_key, unit_manager_.get_cost_model());
+      }
+      catch (std::exception const&) {
+        unit_manager_.get_cost_model().clear();
+      }
+    }
 
     // Keeps track of keys used inside the archive to avoid collision
     std::map<int, size_t> used_keys;
 
+    size_t n_indexed = 0;
+
     for (auto key : archive_.available_objects()) {
-      if (!key->is_valid())
+      if (!key->is_valid() || key->is_metadata())
+        continue;
+
+      size_t& last_obj = used_keys[key->get_node_id()];
+      last_obj = std::max(last_obj, key->get_obj_id());
+
+      // Family lists change as tasks are created, so they can't be shared
+      if (key->get_type() == Key::Parents || key->get_type() == Key::Children)
         continue;
 
-      used_keys[key->node_id] = std::max(used_keys[key->node_id], key->obj_id);
+      auto it = index.find(*key);
+      if (it != index.end()) {
+        get_shard(map_hash_to_key_, it->second).map.emplace(it->second,
+            *key);
+        n_indexed++;
+        continue;
+      }
 
-      std::string data_str = load_string_to_hash(*key);
-      if (data_str == "")
+      it = bytes_index.find(*key);
+      if (it != bytes_index.end()) {
+        get_shard(map_bytes_hash_to_key_, it->second).map.emplace(
+            it->second, *key);
+        n_bytes_hashes_++;
+        n_indexed++;
         continue;
-      size_t hash = hasher(data_str);
-      map_hash_to_key_.emplace(hash, *key);
+      }
+
+      // Tasks entries are known, so they can be fingerprinted like new ones.
+      // Other objects can only be fingerprinted by their stored bytes.
+      if (key->get_type() == Key::Task) {
+        TaskEntry entry;
+        archive_.load(*key, entry);
+        clear_entry_state(entry);
+        std::string data_str;
+        Fingerprint fingerprint = get_fingerprint(entry, data_str);
+        get_shard(map_hash_to_key_, fingerprint).map.emplace(fingerprint,
+            *key);
+      }
+      else {
+        std::string data_str;
+        archive_.load_raw(*key, data_str);
+        if (data_str == "")
+          continue;
+        unit_manager_.get_compressor().decompress(data_str);
+        Fingerprint fingerprint = Fingerprint::of(data_str);
+        get_shard(map_bytes_hash_to_key_, fingerprint).map.emplace(
+            fingerprint, *key);
+        n_bytes_hashes_++;
+      }
+
+      archive_index_changed_ = true;
     }
 
+    // Objects removed from the archive must be removed from the index also
+    if (n_indexed != index.size() + bytes_index.size())
+      archive_index_changed_ = true;
+
+    save_archive_index();
+
     update_used_keys(used_keys);
   }
 
+  void TaskManager::save_archive_index() {
+    flush_family_lists();
+
+    if (id() != 0 || !archive_index_changed_)
+      return;
+
+    ArchiveIndex index;
+    index.task_entry_version = current_task_entry_version;
+    for (auto& shard : map_hash_to_key_) {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      for (auto& it : shard.map)
+        index.objects.emplace_back(it.second, it.first);
+    }
+
+    for (auto& shard : map_bytes_hash_to_key_) {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      for (auto& it : shard.map)
+        index.bytes.emplace_back(it.second, it.first);
+    }
+
+    archive_.insert(archive_index_key, index);
+
+    // Objects serialized through boost are only known by their bytes until
+    // found again and encoded by the fast codec
+    if (legacy_encodings_ && n_bytes_hashes_ == 0)
+      legacy_encodings_ = false;
+    if (!legacy_encodings_)
+      archive_.insert(fast_codec_marker_key, true);
+    archive_index_changed_ = false;
+  }
+
+  void TaskManager::remove_archive_index() {
+    if (id() != 0)
+      return;
+
+    archive_.remove(archive_index_key);
+    archive_index_changed_ = true;
+  }
+
+  void TaskManager::set_scheduling(Scheduling scheduling) {
+    scheduling_ = scheduling;
+  }
+
+  TaskManager::Scheduling TaskManager::get_scheduling() const {
+    return scheduling_;
+  }
+
+  void TaskManager::set_unit_cost(std::string const& unit_id, double cost) {
+    unit_costs_[unit_id] = cost;
+  }
+
+  double TaskManager::get_unit_cost(std::string const& unit_id) const {
+    auto it = unit_costs_.find(unit_id);
+    if (it == unit_costs_.end())
+      return unit_manager_.get_cost_model().get_mean_wall_time(unit_id, 1);
+
+    return it->second;
+  }
+
+  ArchiveOperations TaskManager::get_creation_operations() const {
+    std::lock_guard<std::recursive_mutex> lock(
+        unit_manager_.get_archive_mutex());
+    return creation_operations_;
+  }
+
+  size_t TaskManager::get_number_of_tasks_created() const {
+    std::lock_guard<std::recursive_mutex> lock(
+        unit_manager_.get_archive_mutex());
+    return n_tasks_created_;
+  }
+
+  void TaskManager::set_trust_fingerprints(bool trust_fingerprints) {
+    trust_fingerprints_ = trust_fingerprints;
+  }
+
+  bool TaskManager::get_trust_fingerprints() const {
+    return trust_fingerprints_;
+  }
+
   void TaskManager::set_task_creation_handler(creation_handler_type handler) {
     task_creation_handler_ = handler;
   }
@@ -130,38 +547,103 @@ namespace TaskDistribution {
     return Key::new_key(type);
   }
 
-  void TaskManager::create_family_lists(TaskEntry& entry) {
-    if (!entry.parents_key.is_valid()) {
-      entry.parents_key = new_key(Key::Parents);
-      archive_.insert(entry.parents_key, KeySet());
-    }
+  void TaskManager::load_parents(TaskEntry const& entry,
+      FlatKeySet& parents) {
+    if (entry.parents_key.is_valid())
+      archive_.load(entry.parents_key, parents);
+    else
+      parents = entry.parents;
+  }
 
-    if (!entry.children_key.is_valid()) {
-      entry.children_key = new_key(Key::Children);
-      archive_.insert(entry.children_key, KeySet());
+  void TaskManager::load_children(TaskEntry const& entry,
+      FlatKeySet& children) {
+    if (entry.children_key.is_valid())
+      archive_.load(entry.children_key, children);
+    else
+      children = entry.children;
+  }
+
+  void TaskManager::load_parents(TaskEntry const& entry,
+      FlatKeySet& parents, ArchiveBatch& batch) {
+    if (entry.parents_key.is_valid())
+      batch.load(entry.parents_key, parents);
+    else
+      parents = entry.parents;
+  }
+
+  void TaskManager::load_children(TaskEntry const& entry,
+      FlatKeySet& children, ArchiveBatch& batch) {
+    if (entry.children_key.is_valid())
+      batch.load(entry.children_key, children);
+    else
+      children = entry.children;
+  }
+
+  void TaskManager::store_family_list(FlatKeySet list,
+      FlatKeySet& inline_list, Key& list_key, Key::Type type,
+      ArchiveBatch& batch) {
+    if (!list_key.is_valid() && list.size() <= TaskEntry::max_inline_family) {
+      inline_list = std::move(list);
+      return;
     }
+
+    if (!list_key.is_valid())
+      list_key = new_key(type);
+    batch.insert(list_key, list);
+    inline_list.clear();
   }
 
   void TaskManager::add_dependency(TaskEntry& child_entry,
-      Key const& parent_key, KeySet& parents) {
+      Key const& parent_key, FlatKeySet& parents, ArchiveBatch& batch) {
     TaskEntry parent_entry;
-    archive_.load(parent_key, parent_entry);
+    batch.load(parent_key, parent_entry);
 
-    KeySet children;
-    archive_.load(parent_entry.children_key, children);
+    // Creates edge used to check if tasks are ready to run
+    graph_.add_edge(graph_.insert(parent_key),
+        graph_.insert(child_entry.task_key));
 
-    // Creates map used to check if tasks are ready to run
-    map_task_to_children_[parent_key].insert(child_entry.task_key);
+    parents.insert(parent_key);
+    if (!parent_entry.has_result())
+      child_entry.active_parents++;
 
-    // Only add as active if it's a new parent
-    if (parents.find(parent_key) == parents.end()) {
-      parents.insert(parent_key);
-      if (!parent_entry.result_key.is_valid())
-        child_entry.active_parents++;
-    }
+    // The children list is only stored when flushed, so that a task with
+    // many children isn't loaded and stored again for each of them
+    new_children_[parent_key].push_back(child_entry.task_key);
+  }
 
-    children.insert(child_entry.task_key);
+  void TaskManager::flush_family_lists() {
+    std::lock_guard<std::recursive_mutex> lock(
+        unit_manager_.get_archive_mutex());
+
+    // Tasks are removed as they are stored, freeing their new children
+    ArchiveBatch batch(archive_);
+    size_t n_batched = 0;
+    for (auto it = new_children_.begin(); it != new_children_.end();
+        it = new_children_.erase(it)) {
+      if (n_batched == family_flush_chunk_size) {
+        batch.commit();
+        n_batched = 0;
+      }
+      n_batched++;
+
+      TaskEntry entry;
+      batch.load(it->first, entry);
+
+      FlatKeySet children;
+      load_children(entry, children, batch);
+      size_t n_children = children.size();
+      children.insert(it->second.begin(), it->second.end());
+
+      // Tasks created again are already children
+      if (children.size() == n_children)
+        continue;
+
+      store_family_list(std::move(children), entry.children,
+          entry.children_key, Key::Children, batch);
+      batch.insert(it->first, entry);
+    }
 
-    archive_.insert(parent_entry.children_key, children);
+    batch.commit();
+    creation_operations_ += batch.get_operations();
   }
 };
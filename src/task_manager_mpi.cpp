@@ -1,5 +1,10 @@
 #include "task_manager_mpi.hpp"
 
+#include <boost/mpi/collectives.hpp>
+#include <boost/serialization/map.hpp>
+#include <boost/serialization/string.hpp>
+#include <map>
+
 namespace TaskDistribution {
   MPITaskManager::MPITaskManager(boost::mpi::communicator& world,
       MPIHandler& handler, MPIObjectArchive<Key>& archive,
@@ -40,17 +45,21 @@ namespace TaskDistribution {
 
   void MPITaskManager::run() {
     if (world_.size() > 1) {
+      broadcast_compression_thresholds();
+
       if (world_.rank() == 0)
         run_master();
       else
         run_slave();
     } else
-      run_single();
+      TaskManager::run();
   }
 
   void MPITaskManager::run_master() {
     size_t n_running = 0;
 
+    prepare_ready_queue();
+
     // Process whatever is left for MPI first
     handler_.run();
 
@@ -68,6 +77,16 @@ namespace TaskDistribution {
         unit_manager_.get_tasks_ended();
 
       for (auto& it : finished_tasks) {
+        auto remote_it = remote_tasks_.find(it.first);
+        if (remote_it != remote_tasks_.end()) {
+          double wall_time = std::chrono::duration<double>(
+              std::chrono::steady_clock::now() -
+              remote_it->second.second).count();
+          unit_manager_.get_cost_model().add(remote_it->second.first,
+              wall_time);
+          remote_tasks_.erase(remote_it);
+        }
+
         task_completed(it.first);
         int slave = it.second;
         --tasks_per_node_[slave-1];
@@ -78,6 +97,8 @@ namespace TaskDistribution {
     }
 
     broadcast_finish();
+
+    save_cost_model();
   }
 
   size_t MPITaskManager::allocate_tasks() {
@@ -121,13 +142,12 @@ namespace TaskDistribution {
       if (ready_.empty())
         return false;
 
-      task_key = ready_.front();
-      ready_.pop_front();
+      task_key = ready_.pop();
 
       archive_.load(task_key, entry);
 
       // If we already computed this task, gets the next one
-      if (!entry.result_key.is_valid()) {
+      if (!entry.has_result()) {
         if (entry.run_locally) {
           task_begin_handler_(task_key);
           unit_manager_.process_local(entry);
@@ -138,6 +158,12 @@ namespace TaskDistribution {
       }
     }
 
+    std::string unit_id;
+    load_object(archive_, entry.computing_unit_id_key, unit_id,
+        unit_manager_.get_compressor());
+    remote_tasks_[task_key] =
+      std::make_pair(unit_id, std::chrono::steady_clock::now());
+
     task_begin_handler_(task_key);
     unit_manager_.send_remote(entry, slave);
     return true;
@@ -152,7 +178,7 @@ namespace TaskDistribution {
   bool MPITaskManager::process_key_update(int source, int tag) {
     size_t key;
     world_.recv(source, tag, key);
-    Key::next_obj = std::max(Key::next_obj, key);
+    Key::update_next_obj(key);
 
     return true;
   }
@@ -162,10 +188,62 @@ namespace TaskDistribution {
       world_.send(i, tags_.finish, true);
   }
 
+  void MPITaskManager::broadcast_compression_thresholds() {
+    ObjectCompressor& compressor = unit_manager_.get_compressor();
+    size_t threshold = compressor.get_threshold();
+    std::map<std::string, size_t> unit_thresholds(
+        compressor.get_unit_thresholds().begin(),
+        compressor.get_unit_thresholds().end());
+
+    boost::mpi::broadcast(world_, threshold, 0);
+    boost::mpi::broadcast(world_, unit_thresholds, 0);
+
+    if (world_.rank() != 0) {
+      compressor.set_threshold(threshold);
+      for (auto& it : unit_thresholds)
+        compressor.set_unit_threshold(it.first, it.second);
+    }
+  }
+
+  ObjectCompressor::Statistics MPITaskManager::get_compression_statistics() {
+    ObjectCompressor::Statistics statistics =
+      TaskManager::get_compression_statistics();
+    if (world_.size() == 1)
+      return statistics;
+
+    size_t counts[] = {statistics.n_compressed, statistics.n_incompressible,
+      statistics.original_size, statistics.compressed_size,
+      statistics.n_decompressed};
+    double times[] = {statistics.compression_time,
+      statistics.decompression_time};
+    size_t total_counts[5];
+    double total_times[2];
+    boost::mpi::reduce(world_, counts, 5, total_counts, std::plus<size_t>(),
+        0);
+    boost::mpi::reduce(world_, times, 2, total_times, std::plus<double>(), 0);
+
+    if (world_.rank() == 0) {
+      statistics.n_compressed = total_counts[0];
+      statistics.n_incompressible = total_counts[1];
+      statistics.original_size = total_counts[2];
+      statistics.compressed_size = total_counts[3];
+      statistics.n_decompressed = total_counts[4];
+      statistics.compression_time = total_times[0];
+      statistics.decompression_time = total_times[1];
+    }
+    return statistics;
+  }
+
   size_t MPITaskManager::id() const {
     return world_.rank();
   }
 
+  size_t MPITaskManager::get_number_of_workers() const {
+    if (world_.size() == 1)
+      return TaskManager::get_number_of_workers();
+    return world_.size() - 1;
+  }
+
   void MPITaskManager::update_used_keys(
       std::map<int, size_t> const& used_keys) {
     if (world_.size() == 1)
@@ -173,7 +251,7 @@ namespace TaskDistribution {
     else {
       for (auto it = used_keys.begin(); it != used_keys.end(); ++it) {
         if (it->first == world_.rank())
-          Key::next_obj = std::max(Key::next_obj, it->second + 1);
+          Key::update_next_obj(it->second + 1);
         else
           world_.send(it->first, tags_.key_update, it->second + 1);
       }
@@ -14,12 +14,44 @@ if [ $? != 0 ]
 then
   exit
 fi
+ctest --output-on-failure
+if [ $? != 0 ]
+then
+  exit
+fi
 rm -f example.archive
 ./example/example.bin check
 ./example/example.bin run
 ./example/example.bin invalidate -i 'fibonacci'
 ./example/example.bin clean
+./example/example.bin run -j 2
+cd ..
+
+if [ ! -d build_packed ];
+then
+  mkdir build_packed;
+  cd build_packed;
+  cmake .. -DCMAKE_BUILD_TYPE=Debug -DPACKED_KEY=True
+else
+  cd build_packed;
+fi;
+
+make
+if [ $? != 0 ]
+then
+  exit
+fi
+ctest --output-on-failure
+if [ $? != 0 ]
+then
+  exit
+fi
+rm -f example.archive
+./example/example.bin check
 ./example/example.bin run
+./example/example.bin invalidate -i 'fibonacci'
+./example/example.bin clean
+./example/example.bin run -j 2
 cd ..
 
 if [ ! -d build_mpi ];
@@ -0,0 +1,141 @@
+// Tests of the LZ compression of stored objects.
+
+#include "compression.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace TaskDistribution {
+  static std::string lz_reload(std::string const& data) {
+    std::string compressed;
+    lz_compress(data.data(), data.size(), compressed);
+
+    std::string ret(data.size(), '\0');
+    EXPECT_TRUE(lz_decompress(compressed.data(), compressed.size(), &ret[0],
+          ret.size()));
+    return ret;
+  }
+
+  static std::string make_random(size_t size) {
+    std::mt19937 generator(size);
+    std::string data(size, '\0');
+    for (char& c: data)
+      c = generator();
+    return data;
+  }
+
+  // Numbers with few distinct values, as in typical results.
+  static std::string make_repetitive(size_t size) {
+    std::vector<double> values(size / sizeof(double));
+    for (size_t i = 0; i < values.size(); i++)
+      values[i] = (i % 37) * 0.5;
+    return std::string(reinterpret_cast<char const*>(values.data()),
+        values.size() * sizeof(double));
+  }
+
+  TEST(CompressionTest, RoundTrips) {
+    EXPECT_EQ("", lz_reload(""));
+    EXPECT_EQ("a", lz_reload("a"));
+    EXPECT_EQ("abcabcabcabcabcabc", lz_reload("abcabcabcabcabcabc"));
+    EXPECT_EQ(std::string(1000, 'z'), lz_reload(std::string(1000, 'z')));
+
+    for (size_t size: {15, 300, 70000, 200000}) {
+      EXPECT_EQ(make_random(size), lz_reload(make_random(size)));
+      EXPECT_EQ(make_repetitive(size), lz_reload(make_repetitive(size)));
+    }
+  }
+
+  TEST(CompressionTest, ShrinksRepetitiveData) {
+    std::string data = make_repetitive(100000);
+    std::string compressed;
+    lz_compress(data.data(), data.size(), compressed);
+    EXPECT_LT(compressed.size(), data.size() / 10);
+  }
+
+  TEST(CompressionTest, RejectsCorruptData) {
+    std::string data = make_repetitive(10000) + make_random(1000);
+    std::string compressed;
+    lz_compress(data.data(), data.size(), compressed);
+
+    // Bytes past the output are checked to stay untouched
+    size_t const guard_size = 64;
+    std::string out(data.size() + guard_size, '\x5a');
+    std::string const guard(guard_size, '\x5a');
+
+    EXPECT_FALSE(lz_decompress(compressed.data(), compressed.size() - 1,
+          &out[0], data.size()));
+    EXPECT_FALSE(lz_decompress(compressed.data(), compressed.size(),
+          &out[0], data.size() - 1));
+    EXPECT_FALSE(lz_decompress(compressed.data(), compressed.size(),
+          &out[0], data.size() + 1));
+    EXPECT_EQ(guard.substr(1), out.substr(data.size() + 1));
+
+    // Altered bytes may give other data, but never more than asked for
+    for (size_t i = 0; i < compressed.size(); i++) {
+      std::string altered = compressed;
+      altered[i] = ~altered[i];
+      lz_decompress(altered.data(), altered.size(), &out[0], data.size());
+      ASSERT_EQ(guard, out.substr(data.size())) << "byte " << i;
+    }
+
+    std::string garbage = make_random(5000);
+    lz_decompress(garbage.data(), garbage.size(), &out[0], data.size());
+    EXPECT_EQ(guard, out.substr(data.size()));
+  }
+
+  TEST(CompressionTest, CompressesObjectsOverThreshold) {
+    ObjectCompressor compressor;
+    std::string data = make_repetitive(10000);
+    std::string data_str = data;
+
+    // Compression is disabled by default
+    EXPECT_FALSE(compressor.compress(data_str, "unit"));
+    EXPECT_EQ(data, data_str);
+
+    compressor.set_threshold(data.size() + 1);
+    compressor.set_unit_threshold("small", 100);
+    EXPECT_FALSE(compressor.compress(data_str, "unit"));
+    ASSERT_TRUE(compressor.compress(data_str, "small"));
+    EXPECT_TRUE(ObjectCompressor::is_compressed(data_str));
+    EXPECT_LT(data_str.size(), data.size());
+
+    EXPECT_TRUE(compressor.decompress(data_str));
+    EXPECT_EQ(data, data_str);
+    EXPECT_FALSE(compressor.decompress(data_str));
+
+    // Incompressible objects are kept as they were
+    std::string random = make_random(10000);
+    data_str = random;
+    EXPECT_FALSE(compressor.compress(data_str, "small"));
+    EXPECT_EQ(random, data_str);
+
+    ObjectCompressor::Statistics statistics = compressor.get_statistics();
+    EXPECT_EQ(1u, statistics.n_compressed);
+    EXPECT_EQ(1u, statistics.n_incompressible);
+    EXPECT_EQ(data.size(), statistics.original_size);
+    EXPECT_EQ(1u, statistics.n_decompressed);
+  }
+
+  TEST(CompressionTest, ThrowsOnCorruptObjects) {
+    ObjectCompressor compressor;
+    compressor.set_threshold(0);
+
+    std::string data_str = make_repetitive(10000);
+    ASSERT_TRUE(compressor.compress(data_str, "unit"));
+
+    std::string truncated = data_str.substr(0, data_str.size() / 2);
+    EXPECT_THROW(compressor.decompress(truncated), std::runtime_error);
+
+    // Original size, after the 8-byte header, larger than the data can give
+    std::string oversized = data_str;
+    uint64_t original_size = uint64_t(1) << 40;
+    std::memcpy(&oversized[8], &original_size, sizeof(original_size));
+    EXPECT_THROW(compressor.decompress(oversized), std::runtime_error);
+  }
+};
@@ -0,0 +1,166 @@
+// Tests of the fast codec and of loading objects stored through boost, as they
+// were before the codec.
+
+#include "fast_codec.hpp"
+
+#include <gtest/gtest.h>
+
+#include <boost/serialization/string.hpp>
+#include <boost/serialization/vector.hpp>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "tuple_serialize.hpp"
+
+namespace TaskDistribution {
+  static char const codec_archive_name[] = "fast_codec_test.archive";
+
+  typedef std::tuple<int, std::vector<double>, std::string, char> TestTuple;
+
+  static TestTuple make_tuple() {
+    return TestTuple(-7, {1.5, -2.25, 1e300}, "codec", 'x');
+  }
+
+  template <class T>
+  static T fast_reload(T const& obj) {
+    T ret = T();
+    EXPECT_TRUE(fast_decode(fast_encode(obj), ret));
+    return ret;
+  }
+
+  TEST(FastCodecTest, RoundTrips) {
+    EXPECT_EQ(3.25, fast_reload(3.25));
+    EXPECT_EQ(Key::Result, fast_reload(Key::Result));
+
+    std::vector<double> values({0.5, -1, 2e-10});
+    EXPECT_EQ(values, fast_reload(values));
+    EXPECT_EQ(std::vector<int>(), fast_reload(std::vector<int>()));
+
+    std::string text("with\0zero", 9);
+    EXPECT_EQ(text, fast_reload(text));
+
+    EXPECT_EQ(make_tuple(), fast_reload(make_tuple()));
+  }
+
+  TEST(FastCodecTest, SkipsPositionsOfPartialTuples) {
+    TestTuple tuple = make_tuple();
+    PartialTuple<TestTuple>::Mask skip({{false, true, false, true}});
+    std::string data_str = fast_encode(PartialTuple<TestTuple>(tuple, skip));
+
+    // Skipped positions are kept as they were
+    TestTuple loaded(1, {2.}, "old", 'y');
+    PartialTuple<TestTuple> partial(loaded, skip);
+    ASSERT_TRUE(fast_decode(data_str, partial));
+    EXPECT_EQ(TestTuple(-7, {2.}, "codec", 'y'), loaded);
+
+    EXPECT_LT(data_str.size(), fast_encode(tuple).size());
+  }
+
+  TEST(FastCodecTest, EncodesStoredArgumentsAsPartialTuples) {
+    TestTuple tuple = make_tuple();
+    PartialTuple<TestTuple const>::Mask skip({{false, true, false, true}});
+    PartialTuple<TestTuple const> partial(tuple, skip);
+
+    typedef std::tuple<int const&, std::string const&> StoredTuple;
+    StoredArguments<TestTuple, StoredTuple> stored(
+        StoredTuple(std::get<0>(tuple), std::get<2>(tuple)));
+    EXPECT_EQ(fast_encode(partial), serialize_object(stored));
+
+    // Tuples with types not handled by the codec are stored through boost
+    typedef std::tuple<int, std::vector<bool>> BoostTuple;
+    BoostTuple boost_tuple(5, {true, false});
+    PartialTuple<BoostTuple const>::Mask boost_skip({{true, false}});
+    typedef std::tuple<std::vector<bool> const&> BoostStoredTuple;
+    StoredArguments<BoostTuple, BoostStoredTuple> boost_stored(
+        BoostStoredTuple(std::get<1>(boost_tuple)));
+    EXPECT_EQ(ObjectArchive<Key>::serialize(
+          PartialTuple<BoostTuple const>(boost_tuple, boost_skip)),
+        serialize_object(boost_stored));
+  }
+
+  TEST(FastCodecTest, RejectsOtherEncodings) {
+    std::vector<double> values({1, 2, 3});
+    std::vector<double> loaded;
+    double value;
+
+    // Objects stored through boost
+    EXPECT_FALSE(fast_decode(ObjectArchive<Key>::serialize(values), loaded));
+    EXPECT_FALSE(fast_decode(ObjectArchive<Key>::serialize(2.5), value));
+
+    // Truncated or extended encodings
+    std::string data_str = fast_encode(values);
+    EXPECT_FALSE(fast_decode(data_str.substr(0, data_str.size() - 1),
+          loaded));
+    EXPECT_FALSE(fast_decode(data_str + '\0', loaded));
+
+    // Encodings of other types
+    float float_value;
+    EXPECT_FALSE(fast_decode(fast_encode(2.5), float_value));
+  }
+
+  TEST(FastCodecTest, FindsValuesOfSequences) {
+    std::vector<double> values({1, 2, 3});
+    std::string data_str = fast_encode(values);
+
+    char const* found;
+    size_t n_found;
+    ASSERT_TRUE(fast_find_values<std::vector<double>>(data_str, found,
+          n_found));
+    ASSERT_EQ(values.size(), n_found);
+    EXPECT_EQ(0, std::memcmp(found, values.data(),
+          n_found * sizeof(double)));
+
+    EXPECT_FALSE(fast_find_values<std::vector<double>>(
+          ObjectArchive<Key>::serialize(values), found, n_found));
+  }
+
+  TEST(FastCodecTest, LoadsObjectsStoredThroughBoost) {
+    remove(codec_archive_name);
+
+    {
+      ObjectArchive<Key> archive;
+      archive.init(codec_archive_name);
+
+      ObjectCompressor compressor;
+      compressor.set_threshold(0);
+
+      std::vector<double> values(1000, 0.25);
+      Key boost_key(0, 1, Key::Result);
+      Key fast_key(0, 2, Key::Result);
+      Key compressed_key(0, 3, Key::Result);
+
+      archive.insert(boost_key, values);
+      archive.insert_raw(fast_key, serialize_object(values));
+
+      std::string data_str = serialize_object(values);
+      ASSERT_TRUE(compressor.compress(data_str, "test"));
+      archive.insert_raw(compressed_key, data_str);
+
+      for (Key const& key: {boost_key, fast_key, compressed_key}) {
+        std::vector<double> loaded;
+        load_object(archive, key, loaded, compressor);
+        EXPECT_EQ(values, loaded);
+      }
+
+      // Types not handled by the codec are always stored through boost, and
+      // may be compressed too
+      std::vector<bool> flags(1000, true);
+      EXPECT_EQ(ObjectArchive<Key>::serialize(flags),
+          serialize_object(flags));
+
+      Key flags_key(0, 4, Key::Result);
+      data_str = serialize_object(flags);
+      ASSERT_TRUE(compressor.compress(data_str, "test"));
+      archive.insert_raw(flags_key, data_str);
+
+      std::vector<bool> loaded_flags;
+      load_object(archive, flags_key, loaded_flags, compressor);
+      EXPECT_EQ(flags, loaded_flags);
+    }
+
+    remove(codec_archive_name);
+  }
+};
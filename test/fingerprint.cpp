@@ -0,0 +1,35 @@
+// Tests of the fingerprints of objects serialized through boost.
+
+#include "fingerprint.hpp"
+
+#include <gtest/gtest.h>
+
+#include <boost/serialization/vector.hpp>
+#include <string>
+#include <vector>
+
+#include "key.hpp"
+#include "object_archive.hpp"
+
+namespace TaskDistribution {
+  TEST(FingerprintTest, StreamedLikeSerialization) {
+    std::vector<int> obj({1, 2, 3});
+    std::string data_str = ObjectArchive<Key>::serialize(obj);
+
+    EXPECT_EQ(Fingerprint::of(data_str), Fingerprint::of_object(obj));
+  }
+
+  TEST(FingerprintTest, KeepsSmallSerializations) {
+    std::vector<int> obj(100, 7);
+    std::string data_str = ObjectArchive<Key>::serialize(obj);
+
+    std::string kept("old");
+    EXPECT_EQ(Fingerprint::of(data_str),
+        Fingerprint::of_object(obj, kept, data_str.size()));
+    EXPECT_EQ(data_str, kept);
+
+    EXPECT_EQ(Fingerprint::of(data_str),
+        Fingerprint::of_object(obj, kept, data_str.size() - 1));
+    EXPECT_TRUE(kept.empty());
+  }
+};
@@ -0,0 +1,94 @@
+// Tests that FlatKeySet is stored like a std::set<Key>, so that family lists
+// stored before it was used are still read.
+
+#include "flat_key_set.hpp"
+
+#include <gtest/gtest.h>
+
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+#include <boost/archive/text_iarchive.hpp>
+#include <boost/archive/text_oarchive.hpp>
+#include <boost/serialization/set.hpp>
+#include <algorithm>
+#include <set>
+#include <sstream>
+#include <string>
+
+namespace TaskDistribution {
+  template <class OArchive, class T>
+  static std::string save(T const& obj) {
+    std::ostringstream stream;
+    {
+      OArchive ar(stream);
+      ar << obj;
+    }
+    return stream.str();
+  }
+
+  template <class IArchive, class T>
+  static void load(std::string const& data, T& obj) {
+    std::istringstream stream(data);
+    IArchive ar(stream);
+    ar >> obj;
+  }
+
+  // Keys inserted out of order and repeated.
+  static std::set<Key> make_key_set() {
+    std::set<Key> keys;
+    for (size_t i : {7, 3, 12, 1, 3, 900, 45})
+      keys.insert(Key(0, i, Key::Task));
+    keys.insert(Key(2, 5, Key::Task));
+    return keys;
+  }
+
+  template <class Archives>
+  class FlatKeySetTest: public ::testing::Test { };
+
+  template <class OArchive, class IArchive>
+  struct ArchivePair {
+    typedef OArchive oarchive;
+    typedef IArchive iarchive;
+  };
+
+  typedef ::testing::Types<
+    ArchivePair<boost::archive::binary_oarchive,
+                boost::archive::binary_iarchive>,
+    ArchivePair<boost::archive::text_oarchive,
+                boost::archive::text_iarchive>> ArchiveTypes;
+  TYPED_TEST_CASE(FlatKeySetTest, ArchiveTypes);
+
+  TYPED_TEST(FlatKeySetTest, StoredLikeSet) {
+    std::set<Key> keys = make_key_set();
+    FlatKeySet flat_keys(keys.begin(), keys.end());
+
+    EXPECT_EQ(save<typename TypeParam::oarchive>(keys),
+        save<typename TypeParam::oarchive>(flat_keys));
+
+    std::set<Key> empty;
+    EXPECT_EQ(save<typename TypeParam::oarchive>(empty),
+        save<typename TypeParam::oarchive>(FlatKeySet()));
+  }
+
+  TYPED_TEST(FlatKeySetTest, LoadsStoredSet) {
+    std::set<Key> keys = make_key_set();
+
+    FlatKeySet flat_keys({Key(0, 99, Key::Task)});
+    load<typename TypeParam::iarchive>(
+        save<typename TypeParam::oarchive>(keys), flat_keys);
+
+    ASSERT_EQ(keys.size(), flat_keys.size());
+    EXPECT_TRUE(std::equal(keys.begin(), keys.end(), flat_keys.begin()));
+  }
+
+  TYPED_TEST(FlatKeySetTest, StoredSetIsLoadedBySet) {
+    std::set<Key> keys = make_key_set();
+    FlatKeySet flat_keys(keys.begin(), keys.end());
+
+    std::set<Key> loaded;
+    load<typename TypeParam::iarchive>(
+        save<typename TypeParam::oarchive>(flat_keys), loaded);
+
+    EXPECT_EQ(keys, loaded);
+  }
+};
@@ -0,0 +1,154 @@
+// Tests that task entries stored by older versions are still loaded.
+
+#include "task_entry.hpp"
+
+#include <gtest/gtest.h>
+
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+#include <sstream>
+#include <string>
+
+namespace TaskDistribution {
+  // Entry as stored before lists were kept inline.
+  struct TaskEntryV0 {
+    Key task_key;
+    Key computing_unit_key;
+    Key arguments_key;
+    Key arguments_tasks_key;
+    Key result_key;
+    Key computing_unit_id_key;
+    Key parents_key;
+    Key children_key;
+    size_t active_parents;
+    bool run_locally;
+
+    template<class Archive>
+    void serialize(Archive& ar, const unsigned int version) {
+      ar & task_key;
+      ar & computing_unit_key;
+      ar & arguments_key;
+      ar & arguments_tasks_key;
+      ar & result_key;
+      ar & computing_unit_id_key;
+      ar & parents_key;
+      ar & children_key;
+      ar & active_parents;
+      ar & run_locally;
+    }
+  };
+
+  // Entry as stored before results were kept inline.
+  struct TaskEntryV1: TaskEntryV0 {
+    FlatKeySet parents;
+    FlatKeySet children;
+
+    template<class Archive>
+    void serialize(Archive& ar, const unsigned int version) {
+      TaskEntryV0::serialize(ar, version);
+      ar & parents;
+      ar & children;
+    }
+  };
+};
+
+BOOST_CLASS_VERSION(TaskDistribution::TaskEntryV0, 0);
+BOOST_CLASS_VERSION(TaskDistribution::TaskEntryV1, 1);
+
+namespace TaskDistribution {
+  // Stores the object as the archive does and loads it over another.
+  template <class T, class U>
+  static void reload(T const& stored, U& loaded) {
+    std::ostringstream out;
+    {
+      boost::archive::binary_oarchive ar(out, boost::archive::no_header);
+      ar << stored;
+    }
+
+    std::istringstream in(out.str());
+    boost::archive::binary_iarchive ar(in, boost::archive::no_header);
+    ar >> loaded;
+  }
+
+  static void fill_keys(TaskEntryV0& entry) {
+    entry.task_key = Key(0, 1, Key::Task);
+    entry.computing_unit_key = Key(0, 2, Key::ComputingUnit);
+    entry.arguments_key = Key(0, 3, Key::Arguments);
+    entry.arguments_tasks_key = Key(0, 4, Key::ArgumentsTasks);
+    entry.result_key = Key(0, 5, Key::Result);
+    entry.computing_unit_id_key = Key(0, 6, Key::ComputingUnitId);
+    entry.parents_key = Key(0, 7, Key::Parents);
+    entry.children_key = Key(0, 8, Key::Children);
+    entry.active_parents = 3;
+    entry.run_locally = true;
+  }
+
+  static void expect_keys(TaskEntryV0 const& old_entry,
+      TaskEntry const& entry) {
+    EXPECT_EQ(old_entry.task_key, entry.task_key);
+    EXPECT_EQ(old_entry.computing_unit_key, entry.computing_unit_key);
+    EXPECT_EQ(old_entry.arguments_key, entry.arguments_key);
+    EXPECT_EQ(old_entry.arguments_tasks_key, entry.arguments_tasks_key);
+    EXPECT_EQ(old_entry.result_key, entry.result_key);
+    EXPECT_EQ(old_entry.computing_unit_id_key, entry.computing_unit_id_key);
+    EXPECT_EQ(old_entry.parents_key, entry.parents_key);
+    EXPECT_EQ(old_entry.children_key, entry.children_key);
+    EXPECT_EQ(old_entry.active_parents, entry.active_parents);
+    EXPECT_EQ(old_entry.run_locally, entry.run_locally);
+  }
+
+  // Entry loaded over, so that fields not stored must be reset.
+  static TaskEntry make_used_entry() {
+    TaskEntry entry;
+    entry.parents.insert(Key(1, 1, Key::Task));
+    entry.children.insert(Key(1, 2, Key::Task));
+    entry.store_inline(2.5);
+    return entry;
+  }
+
+  TEST(TaskEntryTest, LoadsVersion0) {
+    TaskEntryV0 old_entry;
+    fill_keys(old_entry);
+
+    TaskEntry entry = make_used_entry();
+    reload(old_entry, entry);
+
+    expect_keys(old_entry, entry);
+    EXPECT_TRUE(entry.parents.empty());
+    EXPECT_TRUE(entry.children.empty());
+    EXPECT_EQ(0u, entry.inline_result_size);
+  }
+
+  TEST(TaskEntryTest, LoadsVersion1) {
+    TaskEntryV1 old_entry;
+    fill_keys(old_entry);
+    old_entry.parents_key = Key();
+    old_entry.parents.insert(Key(0, 20, Key::Task));
+    old_entry.parents.insert(Key(0, 10, Key::Task));
+    old_entry.children.insert(Key(0, 30, Key::Task));
+
+    TaskEntry entry = make_used_entry();
+    reload(old_entry, entry);
+
+    expect_keys(old_entry, entry);
+    EXPECT_EQ(old_entry.parents, entry.parents);
+    EXPECT_EQ(old_entry.children, entry.children);
+    EXPECT_EQ(0u, entry.inline_result_size);
+  }
+
+  TEST(TaskEntryTest, KeepsInlineResult) {
+    TaskEntry stored;
+    stored.task_key = Key(0, 1, Key::Task);
+    stored.children.insert(Key(0, 2, Key::Task));
+    ASSERT_TRUE(stored.store_inline(42.5));
+
+    TaskEntry entry;
+    reload(stored, entry);
+
+    EXPECT_EQ(stored, entry);
+    EXPECT_TRUE(entry.has_result());
+    double result = 0;
+    EXPECT_TRUE(entry.load_inline(result));
+    EXPECT_EQ(42.5, result);
+  }
+};
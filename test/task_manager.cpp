@@ -0,0 +1,224 @@
+// Tests of the task manager running tasks locally.
+
+#include "task_manager.hpp"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <boost/serialization/vector.hpp>
+#include <cstdio>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace TaskDistribution {
+  class TestAdd: public ComputingUnit<TestAdd> {
+    public:
+      TestAdd(): ComputingUnit<TestAdd>("test_add") { }
+
+      double operator()(double a, double b) const {
+        return a + b;
+      }
+  };
+
+  class TestScale: public ComputingUnit<TestScale> {
+    public:
+      TestScale(): ComputingUnit<TestScale>("test_scale") { }
+
+      double operator()(double a, int factor) const {
+        return a * factor;
+      }
+  };
+
+  // Its argument and result aren't handled by the fast codec
+  class TestNegate: public ComputingUnit<TestNegate> {
+    public:
+      TestNegate(): ComputingUnit<TestNegate>("test_negate") { }
+
+      std::vector<bool> operator()(std::vector<bool> const& flags) const {
+        std::vector<bool> ret(flags);
+        ret.flip();
+        return ret;
+      }
+  };
+
+  static char const run_archive_name[] = "task_manager_test.archive";
+  static size_t const n_fibonacci = 30;
+  static size_t const n_scaled = 200;
+
+  // Creates a chain of Fibonacci numbers, each depending on the two before,
+  // and many independent tasks depending on its last number, so that tasks
+  // are released both one by one and all at once.
+  static std::vector<Task<double>> create_tasks(TaskManager& manager) {
+    std::vector<Task<double>> tasks;
+    tasks.push_back(manager.new_identity_task(0.));
+    tasks.push_back(manager.new_identity_task(1.));
+    for (size_t i = 2; i < n_fibonacci; i++)
+      tasks.push_back(manager.new_task(TestAdd(), tasks[i-1], tasks[i-2]));
+
+    Task<double> last = tasks.back();
+    for (size_t i = 0; i < n_scaled; i++)
+      tasks.push_back(manager.new_task(TestScale(), last, int(i)));
+    return tasks;
+  }
+
+  static std::vector<double> expected_values() {
+    std::vector<double> values({0, 1});
+    for (size_t i = 2; i < n_fibonacci; i++)
+      values.push_back(values[i-1] + values[i-2]);
+
+    double last = values.back();
+    for (size_t i = 0; i < n_scaled; i++)
+      values.push_back(last * i);
+    return values;
+  }
+
+  TEST(TaskManagerTest, RunsTasksWithManyThreads) {
+    remove(run_archive_name);
+
+    {
+      ObjectArchive<Key> archive;
+      archive.init(run_archive_name);
+
+      // Identity tasks have their results when created, so they never run
+      size_t n_computed = n_fibonacci - 2 + n_scaled;
+
+      {
+        ComputingUnitManager unit_manager(archive);
+        TaskManager manager(archive, unit_manager);
+        manager.clear_task_creation_handler();
+        manager.set_number_of_threads(4);
+
+        std::atomic<size_t> n_begun(0), n_ended(0);
+        manager.set_task_begin_handler([&](Key const&) { n_begun++; });
+        manager.set_task_end_handler([&](Key const&) { n_ended++; });
+
+        std::vector<Task<double>> tasks = create_tasks(manager);
+        manager.run();
+
+        EXPECT_EQ(n_computed, n_begun);
+        EXPECT_EQ(n_computed, n_ended);
+
+        std::vector<double> values = expected_values();
+        ASSERT_EQ(values.size(), tasks.size());
+        for (size_t i = 0; i < tasks.size(); i++)
+          EXPECT_EQ(values[i], (double)tasks[i]) << "task " << i;
+      }
+
+      // The same tasks created again already have their results
+      {
+        ComputingUnitManager unit_manager(archive);
+        TaskManager manager(archive, unit_manager);
+        manager.clear_task_creation_handler();
+        manager.set_number_of_threads(4);
+        manager.load_archive();
+
+        std::atomic<size_t> n_begun(0);
+        manager.set_task_begin_handler([&](Key const&) { n_begun++; });
+        manager.clear_task_end_handler();
+
+        std::vector<Task<double>> tasks = create_tasks(manager);
+        manager.run();
+
+        EXPECT_EQ(0u, n_begun);
+        EXPECT_EQ(expected_values().back(), (double)tasks.back());
+      }
+    }
+
+    remove(run_archive_name);
+  }
+
+  TEST(TaskManagerTest, CompressesObjectsStoredThroughBoost) {
+    remove(run_archive_name);
+
+    {
+      ObjectArchive<Key> archive;
+      archive.init(run_archive_name);
+
+      ComputingUnitManager unit_manager(archive);
+      TaskManager manager(archive, unit_manager);
+      manager.clear_task_creation_handler();
+      manager.clear_task_begin_handler();
+      manager.clear_task_end_handler();
+      manager.get_compressor().set_threshold(0);
+
+      std::vector<bool> flags(10000, true);
+      Task<std::vector<bool>> negated =
+        manager.new_task(TestNegate(), flags);
+      Task<std::vector<bool>> restored = manager.new_task(TestNegate(),
+          manager.new_identity_task(std::vector<bool>(10000, false)));
+      manager.run();
+
+      EXPECT_EQ(std::vector<bool>(10000, false),
+          (std::vector<bool>)negated);
+      EXPECT_EQ(flags, (std::vector<bool>)restored);
+      EXPECT_LT(0u, manager.get_compression_statistics().n_compressed);
+    }
+
+    remove(run_archive_name);
+  }
+
+  // Archives written before only the arguments given as values were stored
+  // have the full tuple of arguments, with default values for tasks.
+  TEST(TaskManagerTest, FindsArgumentsStoredWithPlaceholders) {
+    remove(run_archive_name);
+
+    {
+      ObjectArchive<Key> archive;
+      archive.init(run_archive_name);
+
+      {
+        ComputingUnitManager unit_manager(archive);
+        TaskManager manager(archive, unit_manager);
+        manager.clear_task_creation_handler();
+        manager.clear_task_begin_handler();
+        manager.clear_task_end_handler();
+
+        manager.new_task(TestScale(), manager.new_identity_task(2.), 3);
+        manager.run();
+      }
+
+      // Makes the archive look as written by the older version, without
+      // the metadata of the fast codec
+      std::vector<Key> keys;
+      for (auto key : archive.available_objects())
+        keys.push_back(*key);
+
+      Key arguments_key;
+      for (Key const& key: keys) {
+        if (key.is_metadata())
+          archive.remove(key);
+        else if (key.get_type() == Key::Arguments) {
+          arguments_key = key;
+          archive.insert(key, std::tuple<double, int>(0., 3));
+        }
+      }
+      ASSERT_TRUE(arguments_key.is_valid());
+
+      {
+        ComputingUnitManager unit_manager(archive);
+        TaskManager manager(archive, unit_manager);
+        manager.clear_task_creation_handler();
+        manager.load_archive();
+
+        std::atomic<size_t> n_begun(0);
+        manager.set_task_begin_handler([&](Key const&) { n_begun++; });
+        manager.clear_task_end_handler();
+
+        Task<double> task = manager.new_task(TestScale(),
+            manager.new_identity_task(2.), 3);
+        manager.run();
+
+        EXPECT_EQ(0u, n_begun);
+        EXPECT_EQ(6., (double)task);
+      }
+
+      // The arguments are stored again without the placeholder
+      std::string data_str;
+      archive.load_raw(arguments_key, data_str);
+      EXPECT_EQ(fast_encode(std::tuple<int>(3)), data_str);
+    }
+
+    remove(run_archive_name);
+  }
+};